@@ -9,11 +9,66 @@
 #include <fmt/color.h>
 #include <fmt/chrono.h>
 #include <filesystem>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <functional>
+#include <array>
+#include <cstring>
+#include <cmath>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <map>
+#include <deque>
+#include <algorithm>
+#include <type_traits>
+#include <string_view>
 #include <sched.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define QUICK_LOGGER_NO_INSTRUMENT __attribute__((no_instrument_function))
+
+/*
+ * USDT probes in the provider "quicklogger", built when QUICK_LOGGER_USDT is defined and
+ * <sys/sdt.h> (systemtap-sdt-dev) is available, otherwise they compile to nothing:
+ *
+ *  enqueue(level, queue, log)                   Log pushed by a producer
+ *  drop(level, queue)                           Log dropped because the queue does not exist
+ *  dequeue(queue, level, log, waitNs)           Log popped by the consumer of the queue
+ *  format_done(queue, level, log, bytes)        line rendered
+ *  write_done(queue, level, log, bytes, ns)     line written to the file, sinks and STDOUT
+ *
+ * e.g. bpftrace -e 'usdt:./app:quicklogger:write_done { @[arg0] = hist(arg4); }'
+ */
+#if defined(QUICK_LOGGER_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define QUICK_LOGGER_PROBE2(name, a, b) DTRACE_PROBE2(quicklogger, name, a, b)
+#define QUICK_LOGGER_PROBE3(name, a, b, c) DTRACE_PROBE3(quicklogger, name, a, b, c)
+#define QUICK_LOGGER_PROBE4(name, a, b, c, d) DTRACE_PROBE4(quicklogger, name, a, b, c, d)
+#define QUICK_LOGGER_PROBE5(name, a, b, c, d, e) DTRACE_PROBE5(quicklogger, name, a, b, c, d, e)
+#endif
+#endif
+#ifndef QUICK_LOGGER_PROBE2
+#define QUICK_LOGGER_PROBE2(name, a, b) do {} while(0)
+#define QUICK_LOGGER_PROBE3(name, a, b, c) do {} while(0)
+#define QUICK_LOGGER_PROBE4(name, a, b, c, d) do {} while(0)
+#define QUICK_LOGGER_PROBE5(name, a, b, c, d, e) do {} while(0)
+#endif
+
 #include "xenium/ramalhete_queue.hpp"
 #include "xenium/reclamation/generic_epoch_based.hpp"
 #include "date.h"
 
+#ifdef QUICK_LOGGER_FUNCTION_TRACE
+extern "C" void __cyg_profile_func_enter(void* function, void* callSite);
+extern "C" void __cyg_profile_func_exit(void* function, void* callSite);
+#endif
 
 namespace QuickLogger {
 
@@ -30,141 +85,3085 @@ const int LOG_TYPES = 6;
 
 std::string logLevelMessages[6] = {"ERROR", "WARN", "FAULT", "INFO", "DEBUG", "TRACE"};
 
+enum LOG_KIND : u_int8_t {
+    MESSAGE_LOG = 0,
+    TIMER_LOG = 1
+};
+
+enum LINE_FORMAT : u_int32_t {
+    TEXT_LINES = 0,
+    JSON_LINES = 1
+};
+
 
 /**
- * @brief Class for the Log Item storing the Log Value and its information.
+ * @brief Appends the given string to out as a quoted and escaped JSON string.
+ */
+inline void AppendJSONString(std::string &out, std::string_view value){
+    out += '"';
+    for(char c : value){
+        switch (c)
+        {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if((unsigned char)c < 0x20){
+                out += fmt::format("\\u{:04x}", (unsigned char)c);
+            }
+            else{
+                out += c;
+            }
+            break;
+        }
+    }
+    out += '"';
+}
+
+
+/**
+ * @brief Immutable block of thread-local context fields (mapped diagnostic context).
+ *
+ * A new block is built when a ContextScope is entered, without any lock, and every Log made
+ * inside the scope holds a reference to that same block, so the fields are never copied per
+ * log. A block is freed once its scope was left and the consumers deleted the last Log
+ * holding it. The version is unique per block and lets the consumers cache the rendered
+ * form of the block they saw last.
  *
- * This Class implements the structure needed for storing the Log value and its
- * accompanying information. Please note that the value is being stored as a
- * std::string which implies the type of data you pass to the Logger to log has
- * to be convertable to string using the fmt::format utility.
- * 
  * Attributes:
- *  * logLevel
- *    Stores the level which the log is intended for.
- *  * value
- *    Stores the actual value of the Log converted to a string. Note that in case 
- *    of a string that needs formatting, the string is initially stored unformatted
- *    and later formatted using the saved args in the consumer thread.
- *  * time
- *    Stores the time of logging of the log.
- *  * parameterFlag
- *    Stores if the log has any parameters using which the value has to be formatted.
- *  * saved_op
- *    A saved method call
- * 
- * Methods:
+ *  * version
+ *    Globally unique, increasing version of this block.
+ *  * fields
+ *    The key/value pairs in the order they were first set.
+ */
+class ContextBlock {
+    public:
+    u_int64_t version;
+    std::vector<std::pair<std::string, std::string>> fields;
+};
+
+/**
+ * @brief Returns the context block currently active on the calling thread.
+ *
+ * The returned pointer is empty when no ContextScope is active.
+ */
+inline std::shared_ptr<const ContextBlock> &CurrentContext(){
+    thread_local std::shared_ptr<const ContextBlock> current;
+    return current;
+}
+
+/**
+ * @brief Returns a new, globally unique context block version.
+ */
+inline u_int64_t NextContextVersion(){
+    static std::atomic<u_int64_t> versions{0};
+    return versions.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+/**
+ * @brief RAII scope setting a context field on the calling thread.
+ *
+ * The field is attached to every log made from this thread until the scope is destroyed,
+ * after which the previous context is restored. Setting a key which is already present
+ * overrides it for the lifetime of the scope.
+ *
+ *      QuickLogger::ContextScope request("request_id", id);
+ *      myLogger.LogItem(QuickLogger::INFO, 0, "order filled");
+ */
+class ContextScope {
+    private:
+        std::shared_ptr<const ContextBlock> previous;
+
+    public:
+        template<typename V>
+        ContextScope(std::string key, V &&value) : previous(CurrentContext()) {
+            auto block = std::make_shared<ContextBlock>();
+            block->version = NextContextVersion();
+            if(previous){
+                block->fields = previous->fields;
+            }
+
+            std::string text = fmt::to_string(std::forward<V>(value));
+            bool replaced = false;
+            for(auto &field : block->fields){
+                if(field.first == key){
+                    field.second = std::move(text);
+                    replaced = true;
+                    break;
+                }
+            }
+            if(!replaced){
+                block->fields.emplace_back(std::move(key), std::move(text));
+            }
+
+            CurrentContext() = std::move(block);
+        }
+
+        ~ContextScope(){
+            CurrentContext() = std::move(previous);
+        }
+
+        ContextScope(ContextScope const&) = delete;
+        void operator=(ContextScope const&) = delete;
+};
+
+
+typedef std::array<u_int8_t, 16> TraceID;
+typedef std::array<u_int8_t, 8>  SpanID;
+
+/**
+ * @brief Returns the lowercase hex representation of a trace or span ID.
+ */
+template<size_t N>
+inline std::string ToHex(const std::array<u_int8_t, N> &bytes){
+    static const char digits[] = "0123456789abcdef";
+    std::string out(2*N, '0');
+    for(size_t i = 0 ; i < N ; i++){
+        out[2*i] = digits[bytes[i] >> 4];
+        out[2*i+1] = digits[bytes[i] & 0xf];
+    }
+    return out;
+}
+
+/**
+ * @brief Parses a trace or span ID from its hex representation.
  * 
- *  @tparam Pointer to Log
- *  @tparam Tuple of variadic arguments saved
- *  * DoOperation:
- *    Defines the formatting operation that needs to be done using the variadic arguments
- *    on the value of the Log given by the point.
+ * @param text              The hex string, must be exactly 2*N characters long
+ * @param bytes             The ID to fill
+ * @return                  `true` if the string was a valid ID, otherwise `false`
+ */
+template<size_t N>
+inline bool FromHex(const std::string &text, std::array<u_int8_t, N> &bytes){
+    if(text.size() != 2*N){
+        return false;
+    }
+    auto nibble = [](char c) -> int {
+        if(c >= '0' && c <= '9') return c - '0';
+        if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    for(size_t i = 0 ; i < N ; i++){
+        int hi = nibble(text[2*i]), lo = nibble(text[2*i+1]);
+        if(hi < 0 || lo < 0){
+            return false;
+        }
+        bytes[i] = (u_int8_t)((hi << 4) | lo);
+    }
+    return true;
+}
+
+/**
+ * @brief Hash for TraceID and SpanID so that they can be used as keys of unordered containers.
+ */
+struct TraceIDHash {
+    template<size_t N>
+    size_t operator()(const std::array<u_int8_t, N> &id) const {
+        static_assert(N % 8 == 0, "IDs are hashed in 8 byte words");
+        u_int64_t hash = 0;
+        for(size_t i = 0 ; i < N ; i += 8){
+            u_int64_t word;
+            std::memcpy(&word, id.data() + i, 8);
+            hash = hash * 0x9e3779b97f4a7c15ULL ^ word;
+        }
+        return std::hash<u_int64_t>()(hash);
+    }
+};
+
+/**
+ * @brief The trace and span a Log belongs to.
+ *
+ * IDs follow the W3C trace context layout, a 16 byte trace ID and an 8 byte span ID, and
+ * are stored inline in every Log. An all zero trace ID means the Log is not part of a trace.
+ */
+class SpanContext {
+    public:
+    TraceID traceID{};
+    SpanID  spanID{};
+
+    bool valid() const {
+        for(auto b : traceID){
+            if(b != 0){
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/**
+ * @brief Returns the span currently active on the calling thread.
+ */
+inline SpanContext &CurrentSpan(){
+    thread_local SpanContext current;
+    return current;
+}
+
+/**
+ * @brief RAII scope making a span current on the calling thread.
+ *
+ * Every log made from this thread while the scope is alive carries its trace and span IDs.
+ * The previous span is restored when the scope is destroyed.
  * 
- *  @tparam Parameter Pack
- *  * BuildOperation:
- *    Bundles the passed parameters into a tuple and constructs a saved operation which is
- *    stored in the saved_op attribute. This enables delayed invocation of the formatting 
- *    method while preserving the variadic arguments.
+ *  * SpanScope()
+ *    Starts a child span of the current span, or a new trace if there is none.
+ *  * SpanScope(traceID)
+ *    Starts a new span in the given trace, e.g. one received with an incoming request.
+ *  * SpanScope(traceID, spanID)
+ *    Makes the given span current as it is.
+ */
+class SpanScope {
+    private:
+        SpanContext previous;
+
+        template<size_t N>
+        static void Randomize(std::array<u_int8_t, N> &bytes){
+            thread_local std::mt19937_64 generator(std::random_device{}() ^ std::hash<std::thread::id>()(std::this_thread::get_id()));
+            for(size_t i = 0 ; i < N ; i += 8){
+                u_int64_t r = generator();
+                std::memcpy(bytes.data() + i, &r, std::min<size_t>(8, N - i));
+            }
+        }
+
+    public:
+        SpanScope() : previous(CurrentSpan()) {
+            SpanContext &span = CurrentSpan();
+            if(!span.valid()){
+                Randomize(span.traceID);
+            }
+            Randomize(span.spanID);
+        }
+
+        SpanScope(const TraceID &traceID) : previous(CurrentSpan()) {
+            SpanContext &span = CurrentSpan();
+            span.traceID = traceID;
+            Randomize(span.spanID);
+        }
+
+        SpanScope(const TraceID &traceID, const SpanID &spanID) : previous(CurrentSpan()) {
+            SpanContext &span = CurrentSpan();
+            span.traceID = traceID;
+            span.spanID = spanID;
+        }
+
+        ~SpanScope(){
+            CurrentSpan() = previous;
+        }
+
+        const SpanContext &span() const {
+            return CurrentSpan();
+        }
+
+        SpanScope(SpanScope const&) = delete;
+        void operator=(SpanScope const&) = delete;
+};
+
+
+/**
+ * @brief Cheap timestamps from the CPU time stamp counter.
  *
+ * now() reads the TSC on x86 and falls back to std::chrono::steady_clock in nanoseconds
+ * elsewhere. Calibrate() measures the tick rate against the system clock once, so the
+ * consumers can convert raw ticks to nanoseconds and to wall clock time. It is called
+ * when the Logger is started.
  */
-class Log {
+class TscClock {
+    private:
+        struct Calibration {
+            double    nanosecondsPerTick = 1.0;
+            u_int64_t anchorTicks = 0;
+            std::chrono::system_clock::time_point anchorTime;
+            bool      calibrated = false;
+        };
+
+        static Calibration &State(){
+            static Calibration calibration;
+            return calibration;
+        }
+
     public:
-    int logLevel;
-    std::string value;
-    std::chrono::high_resolution_clock::time_point time;
-    bool parameterFlag;
+        QUICK_LOGGER_NO_INSTRUMENT static inline u_int64_t now(){
+        #if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+        #else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        #endif
+        }
 
-    typedef std::function<void(Log*)> saved_operation;
+        /**
+         * @brief Measures the tick rate over the given duration. Later calls are ignored.
+         */
+        static void Calibrate(std::chrono::milliseconds duration = std::chrono::milliseconds(10)){
+            Calibration &c = State();
+            if(c.calibrated){
+                return;
+            }
+            auto steadyBegin = std::chrono::steady_clock::now();
+            u_int64_t ticksBegin = now();
+            std::this_thread::sleep_for(duration);
+            auto steadyEnd = std::chrono::steady_clock::now();
+            u_int64_t ticksEnd = now();
+
+            double nanoseconds = std::chrono::duration<double, std::nano>(steadyEnd - steadyBegin).count();
+            if(ticksEnd > ticksBegin){
+                c.nanosecondsPerTick = nanoseconds / (ticksEnd - ticksBegin);
+            }
+            c.anchorTicks = now();
+            c.anchorTime = std::chrono::system_clock::now();
+            c.calibrated = true;
+        }
 
-    saved_operation saved_op;
+        static double NanosecondsPerTick(){
+            return State().nanosecondsPerTick;
+        }
 
-    template<typename ...P>
-    void DoOperation(Log* self, std::tuple<P...> const& tup){
-        std::apply([self](auto &&... args){self->value = fmt::format(fmt::to_string(args)...);}, tup);
+        static u_int64_t ToNanoseconds(u_int64_t ticks){
+            return (u_int64_t)(ticks * State().nanosecondsPerTick);
+        }
+
+        static std::chrono::system_clock::time_point ToTimePoint(u_int64_t ticks){
+            const Calibration &c = State();
+            double offset = ((double)ticks - (double)c.anchorTicks) * c.nanosecondsPerTick;
+            return c.anchorTime + std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::duration<double, std::nano>(offset));
+        }
+};
+
+
+#ifdef QUICK_LOGGER_FUNCTION_TRACE
+
+#ifndef QUICK_LOGGER_FUNCTION_TRACE_RING
+#define QUICK_LOGGER_FUNCTION_TRACE_RING 65536
+#endif
+
+// Microseconds between two drains of the rings by the consumers.
+#ifndef QUICK_LOGGER_FUNCTION_TRACE_DRAIN_US
+#define QUICK_LOGGER_FUNCTION_TRACE_DRAIN_US 1000
+#endif
+
+/**
+ * @brief One function entry or exit recorded by the -finstrument-functions hooks.
+ *
+ * The top bit of tsc is set for exits.
+ */
+struct FunctionEvent {
+    u_int64_t address;
+    u_int64_t tsc;
+};
+
+/**
+ * @brief Single producer single consumer ring of FunctionEvents owned by one thread.
+ *
+ * The owning thread pushes from the instrumentation hooks and a consumer thread of the
+ * Logger drains it. Events are dropped and counted when the ring is full, the hooks
+ * never block. A ring which fills up to half its capacity bumps DrainRequests, so the
+ * consumers drain early instead of waiting for their next periodic drain.
+ */
+class FunctionTraceRing {
+    public:
+    static const u_int64_t EXIT_FLAG = 1ULL << 63;
+    static const size_t CAPACITY = QUICK_LOGGER_FUNCTION_TRACE_RING;
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "QUICK_LOGGER_FUNCTION_TRACE_RING must be a power of two");
+
+    u_int32_t thread;
+    alignas(64) std::atomic<u_int64_t> head{0};
+    std::atomic<u_int64_t> dropped{0};
+    alignas(64) std::atomic<u_int64_t> tail{0};
+    alignas(64) FunctionEvent events[CAPACITY];
+
+    QUICK_LOGGER_NO_INSTRUMENT static std::atomic<u_int64_t> &DrainRequests(){
+        static std::atomic<u_int64_t> requests{0};
+        return requests;
+    }
+
+    QUICK_LOGGER_NO_INSTRUMENT void push(u_int64_t address, u_int64_t tsc){
+        u_int64_t h = head.load(std::memory_order_relaxed);
+        u_int64_t t = tail.load(std::memory_order_acquire);
+        if(h - t >= CAPACITY){
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+        events[h & (CAPACITY - 1)] = FunctionEvent{address, tsc};
+        head.store(h + 1, std::memory_order_release);
+        if(h + 1 - t == CAPACITY / 2){
+            DrainRequests().fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Appends all pending events to out and frees their slots.
+     * 
+     * @return                  The number of events drained
+     */
+    size_t drain(std::vector<FunctionEvent> &out){
+        u_int64_t t = tail.load(std::memory_order_relaxed);
+        u_int64_t h = head.load(std::memory_order_acquire);
+        for(u_int64_t i = t ; i < h ; i++){
+            out.push_back(events[i & (CAPACITY - 1)]);
+        }
+        tail.store(h, std::memory_order_release);
+        return h - t;
+    }
+};
+
+/**
+ * @brief Registry of the rings of all threads that ran an instrumented function.
+ *
+ * Rings are registered on the first event of a thread and kept until the program exits,
+ * so the consumers can drain them without locking. Threads beyond MAX_THREADS are not traced.
+ */
+class FunctionTraceRegistry {
+    public:
+    static constexpr int MAX_THREADS = 1024;
+
+    static std::atomic<FunctionTraceRing*> *Rings(){
+        static std::atomic<FunctionTraceRing*> rings[MAX_THREADS];
+        return rings;
+    }
+
+    static std::atomic<int> &Count(){
+        static std::atomic<int> count{0};
+        return count;
+    }
+
+    QUICK_LOGGER_NO_INSTRUMENT static FunctionTraceRing* Register(){
+        int index = Count().fetch_add(1);
+        if(index >= MAX_THREADS){
+            return nullptr;
+        }
+        FunctionTraceRing* ring = new FunctionTraceRing();
+        ring->thread = index;
+        Rings()[index].store(ring, std::memory_order_release);
+        return ring;
+    }
+};
+
+/**
+ * @brief Records a function entry or exit of the calling thread. Called by the hooks.
+ */
+QUICK_LOGGER_NO_INSTRUMENT inline void RecordFunctionEvent(void* function, bool exit){
+    thread_local FunctionTraceRing* ring = nullptr;
+    thread_local bool registered = false;
+    if(!registered){
+        registered = true;
+        ring = FunctionTraceRegistry::Register();
+    }
+    if(ring == nullptr){
         return;
     }
+    u_int64_t tsc = TscClock::now();
+    ring->push((u_int64_t)(uintptr_t)function, exit ? (tsc | FunctionTraceRing::EXIT_FLAG) : tsc);
+}
 
+#endif
 
-    template<typename ...P>
-    saved_operation BuildOperation(P&&... params) const {
-        auto tup = std::make_tuple(std::forward<P>(params)...);
-        return [tup](Log* self){
-            return self->DoOperation<P...>(self, tup);
-        };
+
+/**
+ * @brief A registered call site of the Logger.
+ *
+ * Sites are registered once per call site by the QUICK_LOG_* macros and live until the
+ * program exits, so Logs refer to them by pointer instead of copying their message.
+ *
+ * Attributes:
+ *  * id
+ *    Index of the site in the order of registration.
+ *  * level
+ *    The level the site logs at.
+ *  * file, line
+ *    Source location of the site.
+ *  * message
+ *    The message (or format string) of the site.
+ */
+class LogSite {
+    public:
+    u_int32_t   id;
+    int         level;
+    const char* file;
+    int         line;
+    const char* message;
+};
+
+/**
+ * @brief Returns the registry holding all the sites registered so far.
+ */
+inline std::deque<LogSite> &SiteRegistry(std::mutex *&lock){
+    static std::mutex registryLock;
+    static std::deque<LogSite> registry;
+    lock = &registryLock;
+    return registry;
+}
+
+/**
+ * @brief Registers a call site. Called once per site by the QUICK_LOG_* macros.
+ * 
+ * @return                  Pointer to the site which stays valid until the program exits
+ */
+inline const LogSite* RegisterSite(int level, const char* file, int line, const char* message){
+    std::mutex *lock;
+    std::deque<LogSite> &registry = SiteRegistry(lock);
+    std::lock_guard<std::mutex> guard(*lock);
+    registry.push_back(LogSite{(u_int32_t)registry.size(), level, file, line, message});
+    return &registry.back();
+}
+
+/**
+ * @brief Returns pointers to all the sites registered so far, ordered by ID.
+ */
+inline std::vector<const LogSite*> RegisteredSites(){
+    std::mutex *lock;
+    std::deque<LogSite> &registry = SiteRegistry(lock);
+    std::lock_guard<std::mutex> guard(*lock);
+    std::vector<const LogSite*> sites;
+    for(auto &site : registry){
+        sites.push_back(&site);
     }
+    return sites;
+}
 
+
+enum FIELD_TYPE : u_int8_t {
+    FIELD_INT = 0,
+    FIELD_UINT = 1,
+    FIELD_DOUBLE = 2,
+    FIELD_BOOL = 3,
+    FIELD_STRING = 4,
+    FIELD_CHAR = 5
+};
+
+/**
+ * @brief A structured key/value field passed to LogFields, created using kv().
+ *
+ * The key views a string literal, numbers and pointers are held by value and everything
+ * else by reference, so it must not outlive the log call it is passed to.
+ */
+template<typename T>
+struct KeyValue {
+    std::string_view key;
+    std::conditional_t<std::is_arithmetic_v<T> || std::is_pointer_v<T>, T, const T&> value;
 };
 
+/**
+ * @brief Creates a structured field. The key has to be a string literal of at most 255
+ * characters: the literal is its own interned copy, so only its address and length are
+ * stored in the Log and read by the consumer.
+ *
+ *      myLogger.LogFields(QuickLogger::INFO, 0, "order filled", kv("id", id), kv("px", px));
+ */
+template<size_t N, typename T>
+inline KeyValue<std::decay_t<const T&>> kv(const char (&key)[N], const T &value){
+    static_assert(N <= 256, "field keys are limited to 255 characters");
+    return KeyValue<std::decay_t<const T&>>{std::string_view(key), value};
+}
+
+// A writable array is a buffer, not a literal, and may be gone before the consumer reads the key.
+template<size_t N, typename T>
+KeyValue<std::decay_t<const T&>> kv(char (&key)[N], const T &value) = delete;
+
+/**
+ * @brief Byte buffer holding the encoded fields of a Log.
+ *
+ * Up to INLINE bytes, enough for a few numeric fields, are stored in the Log itself so that
+ * most Logs with fields need no allocation of their own; larger buffers move to the heap.
+ */
+class FieldBuffer {
+    public:
+        static const size_t INLINE = 64;
+
+        FieldBuffer(){}
+        FieldBuffer(const FieldBuffer &other){
+            append(other.data(), other.size());
+        }
+        FieldBuffer &operator=(const FieldBuffer &other){
+            if(this != &other){
+                count = 0;
+                append(other.data(), other.size());
+            }
+            return *this;
+        }
+
+        const u_int8_t* data() const { return heap ? heap.get() : inlineBytes; }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        u_int8_t operator[](size_t i) const { return data()[i]; }
+
+        void reserve(size_t size){
+            if(size <= capacity){
+                return;
+            }
+            std::unique_ptr<u_int8_t[]> grown(new u_int8_t[size]);
+            std::memcpy(grown.get(), data(), count);
+            heap = std::move(grown);
+            capacity = size;
+        }
+
+        void append(const void* bytes, size_t size){
+            if(count + size > capacity){
+                reserve(std::max(count + size, 2*capacity));
+            }
+            std::memcpy((heap ? heap.get() : inlineBytes) + count, bytes, size);
+            count += size;
+        }
+
+        void push_back(u_int8_t byte){
+            append(&byte, 1);
+        }
+
+    private:
+        u_int8_t                    inlineBytes[INLINE];
+        std::unique_ptr<u_int8_t[]> heap;
+        size_t                      count = 0;
+        size_t                      capacity = INLINE;
+};
+
+/**
+ * @brief A decoded structured field, as passed to the visitor of ForEachField.
+ *
+ * Only the member matching type is valid. key views the literal passed to kv(), text is only
+ * valid during the visit.
+ */
+struct FieldView {
+    std::string_view key;
+    FIELD_TYPE       type;
+    int64_t          i = 0;
+    u_int64_t        u = 0;
+    double           d = 0;
+    bool             b = false;
+    char             c = 0;
+    std::string_view text;
+};
+
+template<typename T>
+constexpr FIELD_TYPE FieldTypeOf(){
+    if constexpr (std::is_same_v<T, bool>) return FIELD_BOOL;
+    else if constexpr (std::is_same_v<T, char>) return FIELD_CHAR;
+    else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) return FIELD_INT;
+    else if constexpr (std::is_integral_v<T>) return FIELD_UINT;
+    else if constexpr (std::is_floating_point_v<T>) return FIELD_DOUBLE;
+    else return FIELD_STRING;
+}
+
+/**
+ * @brief Returns the number of bytes the field takes in the encoded buffer.
+ *
+ * Every field is encoded as the address of its key literal and a 1 byte key length, a
+ * FIELD_TYPE byte and the value: 8 bytes for numbers, 1 byte for bools and chars and a 4
+ * byte length followed by the bytes for strings. Values of other types are converted to
+ * strings using fmt::to_string.
+ */
+template<typename T>
+inline size_t EncodedFieldSize(const KeyValue<T> &field){
+    size_t header = sizeof(const char*) + 1 + 1;
+    if constexpr (FieldTypeOf<T>() == FIELD_BOOL || FieldTypeOf<T>() == FIELD_CHAR) return header + 1;
+    else if constexpr (FieldTypeOf<T>() != FIELD_STRING) return header + 8;
+    else if constexpr (std::is_convertible_v<const T&, std::string_view>) return header + 4 + std::string_view(field.value).size();
+    else return header + 4 + fmt::formatted_size("{}", field.value);
+}
+
+template<typename T>
+inline void EncodeField(FieldBuffer &out, const KeyValue<T> &field){
+    auto append = [&out](const void* data, size_t size){
+        out.append(data, size);
+    };
+    constexpr FIELD_TYPE type = FieldTypeOf<T>();
+    const char* key = field.key.data();
+    append(&key, sizeof(key));
+    out.push_back((u_int8_t)field.key.size());
+    out.push_back(type);
+    if constexpr (type == FIELD_BOOL){
+        out.push_back(field.value ? 1 : 0);
+    }
+    else if constexpr (type == FIELD_CHAR){
+        out.push_back((u_int8_t)field.value);
+    }
+    else if constexpr (type == FIELD_INT){
+        int64_t v = field.value;
+        append(&v, 8);
+    }
+    else if constexpr (type == FIELD_UINT){
+        u_int64_t v = field.value;
+        append(&v, 8);
+    }
+    else if constexpr (type == FIELD_DOUBLE){
+        double v = field.value;
+        append(&v, 8);
+    }
+    else if constexpr (std::is_convertible_v<const T&, std::string_view>){
+        std::string_view v(field.value);
+        u_int32_t length = v.size();
+        append(&length, 4);
+        append(v.data(), v.size());
+    }
+    else{
+        std::string v = fmt::to_string(field.value);
+        u_int32_t length = v.size();
+        append(&length, 4);
+        append(v.data(), v.size());
+    }
+}
+
+/**
+ * @brief Decodes a buffer of fields encoded by EncodeField, calling visitor for every field.
+ */
+template<typename F>
+inline void ForEachField(const FieldBuffer &buffer, F &&visitor){
+    size_t pos = 0;
+    while(pos < buffer.size()){
+        FieldView field;
+        const char* key;
+        std::memcpy(&key, buffer.data() + pos, sizeof(key));
+        pos += sizeof(key);
+        field.key = std::string_view(key, buffer[pos++]);
+        field.type = (FIELD_TYPE)buffer[pos++];
+        switch (field.type)
+        {
+        case FIELD_BOOL:
+            field.b = buffer[pos++] != 0;
+            break;
+        case FIELD_CHAR:
+            field.c = (char)buffer[pos++];
+            field.text = std::string_view(&field.c, 1);
+            break;
+        case FIELD_INT:
+            std::memcpy(&field.i, buffer.data() + pos, 8);
+            pos += 8;
+            break;
+        case FIELD_UINT:
+            std::memcpy(&field.u, buffer.data() + pos, 8);
+            pos += 8;
+            break;
+        case FIELD_DOUBLE:
+            std::memcpy(&field.d, buffer.data() + pos, 8);
+            pos += 8;
+            break;
+        default:
+            u_int32_t length;
+            std::memcpy(&length, buffer.data() + pos, 4);
+            pos += 4;
+            field.text = std::string_view((const char*)buffer.data() + pos, length);
+            pos += length;
+            break;
+        }
+        visitor(field);
+    }
+}
+
+
+/**
+ * @brief Class for the Log Item storing the Log Value and its information.
+ *
+ * This Class implements the structure needed for storing the Log value and its
+ * accompanying information. Please note that the value is being stored as a
+ * std::string which implies the type of data you pass to the Logger to log has
+ * to be convertable to string using the fmt::format utility.
+ * 
+ * Attributes:
+ *  * logLevel
+ *    Stores the level which the log is intended for.
+ *  * value
+ *    Stores the actual value of the Log converted to a string. Note that in case 
+ *    of a string that needs formatting, the string is initially stored unformatted
+ *    and later formatted using the saved args in the consumer thread.
+ *  * time
+ *    Stores the time of logging of the log.
+ *  * parameterFlag
+ *    Stores if the log has any parameters using which the value has to be formatted.
+ *  * context
+ *    The context block active on the producing thread, if any.
+ *  * span
+ *    The trace and span active on the producing thread, if any.
+ *  * site
+ *    The call site the Log was made from when it was logged through a QUICK_LOG_* macro.
+ *  * fields
+ *    The structured fields of the Log, encoded by EncodeField.
+ *  * kind
+ *    Whether the Log is a message or a timer record made by a ScopeTimer.
+ *  * tscBegin, tscEnd
+ *    The raw TscClock timestamps of a timer record.
+ *  * enqueueTicks
+ *    TscClock reading taken right before the Log was pushed into its queue.
+ *  * producer, sequence
+ *    Slot of the producer thread and the number of Logs it sent to the same queue before,
+ *    used to detect lost Logs. producer is -1 for Logs written by the Logger itself.
+ *  * saved_op
+ *    A saved method call
+ * 
+ * Methods:
+ * 
+ *  @tparam Pointer to Log
+ *  @tparam Tuple of variadic arguments saved
+ *  * DoOperation:
+ *    Defines the formatting operation that needs to be done using the variadic arguments
+ *    on the value of the Log given by the point. The value holds the format string until then.
+ * 
+ *  @tparam Parameter Pack
+ *  * BuildOperation:
+ *    Bundles the passed parameters into a tuple and constructs a saved operation which is
+ *    stored in the saved_op attribute. This enables delayed invocation of the formatting 
+ *    method while preserving the variadic arguments.
+ *
+ */
+class Log {
+    public:
+    int logLevel;
+    std::string value;
+    std::chrono::high_resolution_clock::time_point time;
+    bool parameterFlag;
+    std::shared_ptr<const ContextBlock> context;
+    SpanContext span;
+    const LogSite* site = nullptr;
+    FieldBuffer fields;
+    LOG_KIND kind = MESSAGE_LOG;
+    u_int64_t tscBegin = 0;
+    u_int64_t tscEnd = 0;
+    u_int64_t enqueueTicks = 0;
+    int producer = -1;
+    u_int64_t sequence = 0;
+
+    typedef std::function<void(Log*)> saved_operation;
+
+    saved_operation saved_op;
+
+    template<typename ...P>
+    void DoOperation(Log* self, std::tuple<P...> const& tup){
+        std::apply([self](auto &&... args){self->value = fmt::format(self->value, fmt::to_string(args)...);}, tup);
+        return;
+    }
+
+
+    template<typename ...P>
+    saved_operation BuildOperation(P&&... params) const {
+        auto tup = std::make_tuple(std::forward<P>(params)...);
+        return [tup](Log* self){
+            return self->DoOperation(self, tup);
+        };
+    }
+
+};
+
+
+/**
+ * @brief Interface for additional outputs of the Logger.
+ *
+ * Sinks receive every Log after it has been formatted, together with the rendered line
+ * which is written to the log files. Since all consumer threads write to the same sinks,
+ * implementations have to be thread safe. Sinks are added with QuickLogger::addSink before
+ * the Logger is started and are flushed when it is stopped.
+ */
+class LogSink {
+    public:
+    virtual ~LogSink() = default;
+
+    /**
+     * @brief Receives a formatted Log.
+     * 
+     * @param log               Pointer to the Log, only valid for the duration of the call
+     * @param consumerID        The ID of the consumer thread handing over the Log
+     * @param line              The rendered line, including the trailing newline
+     */
+    virtual void write(const Log* log, int consumerID, const std::string &line) = 0;
+
+    virtual void flush(){}
+};
+
+
+/**
+ * @brief Sink indexing every traced Log by its trace ID.
+ *
+ * The lines of all Logs carrying a trace are appended to TRACES.log in the given directory
+ * and for every line an entry "<trace id> <offset> <length>" is appended to TRACES.idx, so
+ * offline tools can seek to the lines of a trace directly. The index is also kept in
+ * memory, loaded from TRACES.idx when the sink is created, so records() returns the lines
+ * of a trace from earlier runs as well without scanning the file.
+ */
+class TraceIndexSink : public LogSink {
+    private:
+        std::mutex   lock;
+        std::FILE*   dataFile = nullptr;
+        std::FILE*   indexFile = nullptr;
+        long         dataEnd = 0;
+        std::unordered_map<TraceID, std::vector<std::pair<long, size_t>>, TraceIDHash> offsets;
+
+        /**
+         * @brief Loads the entries of an existing index into memory.
+         * 
+         * Entries which are malformed or point past the end of TRACES.log, e.g. after the
+         * log was truncated, are skipped.
+         * 
+         * @param path              Path of TRACES.idx
+         */
+        void LoadIndex(const std::filesystem::path &path){
+            std::FILE* in = std::fopen(path.c_str(), "r");
+            if(in == nullptr){
+                return;
+            }
+            char hex[64];
+            long offset;
+            size_t length;
+            while(std::fscanf(in, "%63s %ld %zu", hex, &offset, &length) == 3){
+                TraceID traceID;
+                if(FromHex(hex, traceID) && offset >= 0 && offset + (long)length <= dataEnd){
+                    offsets[traceID].emplace_back(offset, length);
+                }
+            }
+            fclose(in);
+        }
+
+    public:
+        /**
+         * @param directory         Path of the directory for TRACES.log and TRACES.idx.
+         *                          Created if it doesn't exist.
+         */
+        TraceIndexSink(std::string directory){
+            std::filesystem::path p = directory;
+            if(!std::filesystem::is_directory(p)){
+                std::filesystem::create_directories(p);
+            }
+            dataFile = std::fopen((p / "TRACES.log").c_str(), "a+b");
+            indexFile = std::fopen((p / "TRACES.idx").c_str(), "a");
+            if(dataFile == nullptr || indexFile == nullptr){
+                std::cerr<<"Unable to open trace index files in "<<p<<"\n";
+                return;
+            }
+            std::fseek(dataFile, 0, SEEK_END);
+            dataEnd = std::ftell(dataFile);
+            LoadIndex(p / "TRACES.idx");
+        }
+
+        ~TraceIndexSink(){
+            if(dataFile != nullptr){
+                fclose(dataFile);
+            }
+            if(indexFile != nullptr){
+                fclose(indexFile);
+            }
+        }
+
+        void write(const Log* log, int, const std::string &line) override {
+            if(!log->span.valid() || dataFile == nullptr || indexFile == nullptr){
+                return;
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            // records() reads from the same stream, switching back to output needs a seek.
+            std::fseek(dataFile, 0, SEEK_END);
+            std::fwrite(line.data(), 1, line.size(), dataFile);
+            fmt::print(indexFile, "{} {} {}\n", ToHex(log->span.traceID), dataEnd, line.size());
+            offsets[log->span.traceID].emplace_back(dataEnd, line.size());
+            dataEnd += line.size();
+        }
+
+        void flush() override {
+            std::lock_guard<std::mutex> guard(lock);
+            if(dataFile != nullptr){
+                std::fflush(dataFile);
+            }
+            if(indexFile != nullptr){
+                std::fflush(indexFile);
+            }
+        }
+
+        /**
+         * @brief Returns all lines written for the given trace, in the order they were written.
+         */
+        std::vector<std::string> records(const TraceID &traceID){
+            std::vector<std::string> lines;
+            std::lock_guard<std::mutex> guard(lock);
+            auto it = offsets.find(traceID);
+            if(it == offsets.end()){
+                return lines;
+            }
+            std::fflush(dataFile);
+            for(auto &entry : it->second){
+                std::string line(entry.second, '\0');
+                std::fseek(dataFile, entry.first, SEEK_SET);
+                size_t got = std::fread(line.data(), 1, entry.second, dataFile);
+                line.resize(got);
+                lines.push_back(std::move(line));
+            }
+            return lines;
+        }
+};
+
+
+/**
+ * @brief Sink writing timer and message Logs as Chrome trace events.
+ *
+ * The file uses the JSON array format of the trace event format, which chrome://tracing
+ * and the Perfetto UI open directly. Timer records become complete ("X") events with their
+ * duration, all other Logs become instant ("i") events. Events are placed on one track per
+ * producer thread (tid), where scope timers nest as their scopes did, and carry the trace
+ * and span IDs of the Log as arguments. Every span becomes an async ("b"/"e") slice from
+ * its first to its last record. Spans carry no end record of their own, so a span is
+ * written and forgotten once none of its records arrived for spanTimeout of log time, or,
+ * oldest first, when more than maxSpans are open; a record arriving after that starts a
+ * second slice of the span. Events are buffered and written in chunks of chunkSize bytes;
+ * the closing bracket is written when the sink is destroyed, viewers accept files without it.
+ */
+class ChromeTraceSink : public LogSink {
+    private:
+        std::mutex          lock;
+        std::FILE*          file = nullptr;
+        std::string         buffer;
+        size_t              chunkSize;
+        bool                first = true;
+        int                 pid = getpid();
+        std::vector<bool>   namedTracks;
+
+        struct SpanExtent {
+            TraceID traceID;
+            double  begin;
+            double  end;
+            int     tid;
+        };
+        std::unordered_map<SpanID, SpanExtent, TraceIDHash> spans;
+        double              spanTimeout;
+        size_t              maxSpans;
+        double              lastSweep = 0;
+
+        void WriteSpan(const SpanID &spanID, const SpanExtent &span){
+            std::string id = ToHex(spanID);
+            std::string args = "\"args\":{\"trace_id\":\"" + ToHex(span.traceID) + "\"}";
+            Append(fmt::format("{{\"name\":\"span {}\",\"cat\":\"span\",\"ph\":\"b\",\"id\":\"0x{}\",\"ts\":{:.3f},\"pid\":{},\"tid\":{},{}}}",
+                               id, id, span.begin, pid, span.tid, args));
+            Append(fmt::format("{{\"name\":\"span {}\",\"cat\":\"span\",\"ph\":\"e\",\"id\":\"0x{}\",\"ts\":{:.3f},\"pid\":{},\"tid\":{},{}}}",
+                               id, id, span.end, pid, span.tid, args));
+        }
+
+        /**
+         * @brief Writes and forgets the spans without a record since spanTimeout before now,
+         * then the oldest ones until at most half of maxSpans are left open.
+         */
+        void SweepSpans(double now){
+            lastSweep = now;
+            for(auto it = spans.begin() ; it != spans.end() ; ){
+                if(now - it->second.end > spanTimeout){
+                    WriteSpan(it->first, it->second);
+                    it = spans.erase(it);
+                }
+                else{
+                    ++it;
+                }
+            }
+            if(spans.size() <= maxSpans){
+                return;
+            }
+            std::vector<std::pair<double, SpanID>> ends;
+            ends.reserve(spans.size());
+            for(auto &span : spans){
+                ends.emplace_back(span.second.end, span.first);
+            }
+            size_t close = spans.size() - maxSpans / 2;
+            std::nth_element(ends.begin(), ends.begin() + close, ends.end(),
+                             [](const std::pair<double, SpanID> &a, const std::pair<double, SpanID> &b){ return a.first < b.first; });
+            for(size_t i = 0 ; i < close ; i++){
+                auto it = spans.find(ends[i].second);
+                WriteSpan(it->first, it->second);
+                spans.erase(it);
+            }
+        }
+
+        void Append(const std::string &event){
+            buffer += first ? "\n" : ",\n";
+            buffer += event;
+            first = false;
+            if(buffer.size() >= chunkSize){
+                WriteBuffer();
+            }
+        }
+
+        void WriteBuffer(){
+            if(file != nullptr && !buffer.empty()){
+                std::fwrite(buffer.data(), 1, buffer.size(), file);
+            }
+            buffer.clear();
+        }
+
+    public:
+        /**
+         * @param path              Path of the trace file, which is overwritten
+         * @param chunkSize         Number of bytes buffered before they are written
+         * @param spanTimeout       Time without a record after which a span is written
+         * @param maxSpans          Number of open spans above which the oldest are written
+         */
+        ChromeTraceSink(std::string path, size_t chunkSize = 1 << 16,
+                        std::chrono::nanoseconds spanTimeout = std::chrono::seconds(1), size_t maxSpans = 1 << 16)
+            : chunkSize(chunkSize), spanTimeout(spanTimeout.count() / 1000.0), maxSpans(std::max<size_t>(maxSpans, 1)) {
+            file = std::fopen(path.c_str(), "w");
+            if(file == nullptr){
+                std::cerr<<"Unable to open trace file "<<path<<"\n";
+                return;
+            }
+            std::fputs("[", file);
+        }
+
+        ~ChromeTraceSink(){
+            if(file != nullptr){
+                for(auto &span : spans){
+                    WriteSpan(span.first, span.second);
+                }
+                WriteBuffer();
+                std::fputs("\n]\n", file);
+                fclose(file);
+            }
+        }
+
+        void write(const Log* log, int, const std::string&) override {
+            double ts = std::chrono::duration<double, std::micro>(log->time.time_since_epoch()).count();
+            double end = ts;
+            const char* name = log->site != nullptr ? log->site->message : nullptr;
+            // Track 0 holds the Logs of the Logger itself, producer slot n is track n + 1.
+            int tid = log->producer + 1;
+
+            std::string event = "{\"name\":";
+            AppendJSONString(event, name != nullptr ? std::string(name) : log->value);
+            event += ",\"cat\":";
+            AppendJSONString(event, logLevelMessages[log->logLevel]);
+            if(log->kind == TIMER_LOG){
+                double duration = TscClock::ToNanoseconds(log->tscEnd - log->tscBegin) / 1000.0;
+                event += fmt::format(",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f}", ts, duration);
+                end = ts + duration;
+            }
+            else{
+                event += fmt::format(",\"ph\":\"i\",\"s\":\"t\",\"ts\":{:.3f}", ts);
+            }
+            event += fmt::format(",\"pid\":{},\"tid\":{},\"args\":{{", pid, tid);
+            bool hasArgs = false;
+            if(log->kind != TIMER_LOG && name != nullptr){
+                event += "\"message\":";
+                AppendJSONString(event, log->value);
+                hasArgs = true;
+            }
+            if(log->span.valid()){
+                event += hasArgs ? "," : "";
+                event += "\"trace_id\":\"" + ToHex(log->span.traceID) + "\",\"span_id\":\"" + ToHex(log->span.spanID) + "\"";
+            }
+            event += "}}";
+
+            std::lock_guard<std::mutex> guard(lock);
+            if((size_t)tid >= namedTracks.size()){
+                namedTracks.resize(tid + 1, false);
+            }
+            if(!namedTracks[tid]){
+                namedTracks[tid] = true;
+                std::string track = tid == 0 ? std::string("logger") : fmt::format("producer {}", tid - 1);
+                Append(fmt::format("{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":{},\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}", pid, tid, track));
+            }
+            if(log->span.valid()){
+                auto it = spans.find(log->span.spanID);
+                if(it == spans.end()){
+                    spans.emplace(log->span.spanID, SpanExtent{log->span.traceID, ts, end, tid});
+                }
+                else{
+                    it->second.begin = std::min(it->second.begin, ts);
+                    it->second.end = std::max(it->second.end, end);
+                }
+            }
+            Append(event);
+            if(spans.size() > maxSpans || ts - lastSweep >= spanTimeout / 4){
+                SweepSpans(ts);
+            }
+        }
+
+        void flush() override {
+            std::lock_guard<std::mutex> guard(lock);
+            WriteBuffer();
+            if(file != nullptr){
+                std::fflush(file);
+            }
+        }
+};
+
+
+/**
+ * @brief Sink discarding every line.
+ *
+ * Together with setFileOutput(false) the consumers still format and render every Log but
+ * write nothing, which isolates the formatting cost from the cost of the output.
+ */
+class NullSink : public LogSink {
+    public:
+        void write(const Log*, int, const std::string&) override {}
+};
+
+
+/**
+ * @brief Sink appending the lines to memory, one buffer per consumer.
+ *
+ * Every buffer holds at most limit bytes and is cleared when the next line does not fit,
+ * so a long run keeps its most recent lines without growing. Consumers beyond the number of
+ * buffers share them; a lock per buffer keeps helping consumers and readers safe.
+ */
+class MemorySink : public LogSink {
+    private:
+        struct Buffer {
+            std::mutex  lock;
+            std::string text;
+            u_int64_t   bytes = 0;
+        };
+
+        std::vector<std::unique_ptr<Buffer>> buffers;
+        size_t                               limit;
+
+    public:
+        /**
+         * @param consumers         Number of buffers, usually the number of consumers
+         * @param limit             Maximum number of bytes kept per buffer
+         */
+        MemorySink(int consumers, size_t limit = 64 << 20) : limit(limit) {
+            for(int i = 0 ; i < std::max(consumers, 1) ; i++){
+                buffers.emplace_back(new Buffer());
+            }
+        }
+
+        void write(const Log*, int consumerID, const std::string &line) override {
+            Buffer &buffer = *buffers[(size_t)std::max(consumerID, 0) % buffers.size()];
+            std::lock_guard<std::mutex> guard(buffer.lock);
+            if(buffer.text.size() + line.size() > limit){
+                buffer.text.clear();
+            }
+            buffer.text += line;
+            buffer.bytes += line.size();
+        }
+
+        /**
+         * @brief Returns the lines kept in memory, buffer by buffer.
+         */
+        std::string contents(){
+            std::string out;
+            for(auto &buffer : buffers){
+                std::lock_guard<std::mutex> guard(buffer->lock);
+                out += buffer->text;
+            }
+            return out;
+        }
+
+        /**
+         * @brief Returns the number of bytes written to the sink, including the cleared ones.
+         */
+        u_int64_t bytes(){
+            u_int64_t total = 0;
+            for(auto &buffer : buffers){
+                std::lock_guard<std::mutex> guard(buffer->lock);
+                total += buffer->bytes;
+            }
+            return total;
+        }
+};
+
+
+/**
+ * @brief Log-linear histogram of unsigned values, in the style of HdrHistogram.
+ *
+ * Values below 64 are counted exactly, larger values in 32 linear sub-buckets per power of
+ * two, which bounds the relative error of the reported values to about 3%. The buckets are
+ * relaxed atomics so one thread can record while any other thread reads or copies the
+ * histogram; recording from more than one thread at a time is not supported.
+ */
+class Histogram {
+    public:
+    static const int SUB_BUCKET_BITS = 5;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    // Shifts 0 to 58 with two sub-bucket ranges for shift 0, i.e. values up to UINT64_MAX.
+    static const int BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    private:
+        std::unique_ptr<std::atomic<u_int64_t>[]> buckets;
+        std::atomic<u_int64_t> total{0};
+        std::atomic<u_int64_t> sum{0};
+        std::atomic<u_int64_t> minimum{UINT64_MAX};
+        std::atomic<u_int64_t> maximum{0};
+
+        static void Add(std::atomic<u_int64_t> &counter, u_int64_t value){
+            counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+
+    public:
+        Histogram() : buckets(new std::atomic<u_int64_t>[BUCKETS]) {
+            reset();
+        }
+
+        Histogram(const Histogram &other) : Histogram() {
+            merge(other);
+        }
+
+        Histogram &operator=(const Histogram &other){
+            if(this != &other){
+                reset();
+                merge(other);
+            }
+            return *this;
+        }
+
+        static constexpr int BucketIndex(u_int64_t value){
+            int shift = 63 - __builtin_clzll(value | 1) - SUB_BUCKET_BITS;
+            if(shift < 0){
+                shift = 0;
+            }
+            return shift * SUB_BUCKETS + (int)(value >> shift);
+        }
+
+        /**
+         * @brief Returns the highest value which is counted in the given bucket.
+         */
+        static u_int64_t BucketValue(int index){
+            if(index < 2 * SUB_BUCKETS){
+                return index;
+            }
+            int shift = index / SUB_BUCKETS - 1;
+            u_int64_t mantissa = index - shift * SUB_BUCKETS;
+            return ((mantissa + 1) << shift) - 1;
+        }
+
+        void record(u_int64_t value){
+            Add(buckets[BucketIndex(value)], 1);
+            Add(total, 1);
+            Add(sum, value);
+            if(value < minimum.load(std::memory_order_relaxed)){
+                minimum.store(value, std::memory_order_relaxed);
+            }
+            if(value > maximum.load(std::memory_order_relaxed)){
+                maximum.store(value, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * @brief Adds all values of other to this histogram. Not safe against concurrent record().
+         */
+        void merge(const Histogram &other){
+            for(int i = 0 ; i < BUCKETS ; i++){
+                Add(buckets[i], other.buckets[i].load(std::memory_order_relaxed));
+            }
+            Add(total, other.count());
+            Add(sum, other.sum.load(std::memory_order_relaxed));
+            minimum.store(std::min(minimum.load(std::memory_order_relaxed), other.minimum.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+            maximum.store(std::max(maximum.load(std::memory_order_relaxed), other.maximum.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+        }
+
+        void reset(){
+            for(int i = 0 ; i < BUCKETS ; i++){
+                buckets[i].store(0, std::memory_order_relaxed);
+            }
+            total.store(0, std::memory_order_relaxed);
+            sum.store(0, std::memory_order_relaxed);
+            minimum.store(UINT64_MAX, std::memory_order_relaxed);
+            maximum.store(0, std::memory_order_relaxed);
+        }
+
+        u_int64_t count() const { return total.load(std::memory_order_relaxed); }
+        u_int64_t min() const { return count() == 0 ? 0 : minimum.load(std::memory_order_relaxed); }
+        u_int64_t max() const { return maximum.load(std::memory_order_relaxed); }
+        double mean() const { return count() == 0 ? 0 : (double)sum.load(std::memory_order_relaxed) / count(); }
+
+        /**
+         * @brief Returns the value below which the given fraction of the recorded values lie.
+         * 
+         * @param quantile          Fraction between 0 and 1, e.g. 0.999 for p99.9
+         */
+        u_int64_t percentile(double quantile) const {
+            u_int64_t n = count();
+            if(n == 0){
+                return 0;
+            }
+            u_int64_t target = (u_int64_t)std::ceil(quantile * n);
+            if(target == 0){
+                target = 1;
+            }
+            u_int64_t seen = 0;
+            for(int i = 0 ; i < BUCKETS ; i++){
+                seen += buckets[i].load(std::memory_order_relaxed);
+                if(seen >= target){
+                    return std::min(BucketValue(i), max());
+                }
+            }
+            return max();
+        }
+};
+
+// Wrapped TSC deltas are huge, the largest values must still land inside the buckets.
+static_assert(Histogram::BucketIndex(UINT64_MAX) < Histogram::BUCKETS, "Histogram buckets do not cover UINT64_MAX");
+static_assert(Histogram::BucketIndex(1ULL << 63) < Histogram::BUCKETS, "Histogram buckets do not cover 2^63");
+
+
+/**
+ * @brief Marks a site or a level as metrics-only, see QuickLogger::AggregateSite.
+ *
+ * Attributes:
+ *  * message
+ *    The message of the sites the rule applies to, empty for level rules.
+ *  * level
+ *    The level the rule applies to, -1 for site rules.
+ *  * field
+ *    Key of the numeric structured field recorded in the histogram, or nullptr for the
+ *    first numeric field of the Log.
+ */
+class MetricsRule {
+    public:
+    std::string message;
+    int         level;
+    const char* field;
+};
+
+/**
+ * @brief Summary of the Logs aggregated for one site or level during one report interval.
+ */
+class MetricsSummary {
+    public:
+    std::string name;
+    int         level;
+    int         consumerID;
+    std::string field;
+    u_int64_t   count;
+    double      rate;
+    Histogram   histogram;
+};
+
+/**
+ * @brief Per consumer aggregation of metrics-only Logs.
+ *
+ * Each consumer thread owns one aggregator, so no synchronization is needed while counting.
+ * Logs matched by a MetricsRule are counted, their numeric field is recorded in a histogram
+ * and they are not written. Values are rounded to integers and negative values count as 0.
+ */
+class MetricsAggregator {
+    private:
+        struct Entry {
+            std::string name;
+            int         level;
+            const char* field;
+            u_int64_t   count = 0;
+            Histogram   histogram;
+        };
+
+        const std::vector<MetricsRule> &rules;
+        std::vector<int> siteRules;
+        std::unordered_map<long, Entry> aggregates;
+        std::chrono::steady_clock::time_point windowStart = std::chrono::steady_clock::now();
+
+        int RuleFor(const Log* log){
+            if(log->site != nullptr){
+                u_int32_t id = log->site->id;
+                if(id >= siteRules.size()){
+                    siteRules.resize(id + 1, -2);
+                }
+                if(siteRules[id] == -2){
+                    siteRules[id] = -1;
+                    for(size_t i = 0 ; i < rules.size() ; i++){
+                        if(rules[i].level < 0 && rules[i].message == log->site->message){
+                            siteRules[id] = i;
+                            break;
+                        }
+                    }
+                }
+                if(siteRules[id] >= 0){
+                    return siteRules[id];
+                }
+            }
+            for(size_t i = 0 ; i < rules.size() ; i++){
+                if(rules[i].level == log->logLevel){
+                    return i;
+                }
+            }
+            return -1;
+        }
+
+    public:
+        MetricsAggregator(const std::vector<MetricsRule> &rules) : rules(rules) {}
+
+        bool empty() const {
+            return rules.empty();
+        }
+
+        /**
+         * @brief Aggregates the Log if a rule matches it.
+         * 
+         * @param log               Pointer to the Log
+         * @param value             Value to record instead of a structured field, if not negative
+         * @return                  `true` if the Log was aggregated and must not be written
+         */
+        bool Aggregate(const Log* log, int64_t value = -1){
+            if(rules.empty()){
+                return false;
+            }
+            int rule = RuleFor(log);
+            if(rule < 0){
+                return false;
+            }
+
+            const MetricsRule &r = rules[rule];
+            bool bySite = r.level < 0;
+            long key = bySite ? (long)log->site->id : -1 - (long)r.level;
+            auto it = aggregates.find(key);
+            if(it == aggregates.end()){
+                Entry a;
+                a.name = bySite ? std::string(log->site->message) : logLevelMessages[r.level];
+                a.level = log->logLevel;
+                a.field = r.field;
+                it = aggregates.emplace(key, std::move(a)).first;
+            }
+            Entry &a = it->second;
+            a.count++;
+
+            if(value < 0){
+                bool found = false;
+                ForEachField(log->fields, [&](const FieldView &field){
+                    if(found || (r.field != nullptr && field.key != r.field)){
+                        return;
+                    }
+                    switch (field.type)
+                    {
+                    case FIELD_INT:    value = field.i; found = true; break;
+                    case FIELD_UINT:   value = (int64_t)field.u; found = true; break;
+                    case FIELD_DOUBLE: value = (int64_t)std::llround(field.d); found = true; break;
+                    case FIELD_BOOL:   value = field.b; found = true; break;
+                    default: break;
+                    }
+                });
+                if(!found){
+                    return true;
+                }
+            }
+            a.histogram.record(value < 0 ? 0 : (u_int64_t)value);
+            return true;
+        }
+
+        /**
+         * @brief Calls report for every site or level aggregated since the last call, then resets.
+         */
+        template<typename F>
+        void Report(int consumerID, F &&report){
+            auto now = std::chrono::steady_clock::now();
+            double seconds = std::chrono::duration<double>(now - windowStart).count();
+            windowStart = now;
+            for(auto &entry : aggregates){
+                Entry &a = entry.second;
+                if(a.count == 0){
+                    continue;
+                }
+                MetricsSummary summary;
+                summary.name = a.name;
+                summary.level = a.level;
+                summary.consumerID = consumerID;
+                summary.field = a.field != nullptr ? a.field : "";
+                summary.count = a.count;
+                summary.rate = seconds > 0 ? a.count / seconds : 0;
+                summary.histogram = a.histogram;
+                report(summary);
+                a.count = 0;
+                a.histogram.reset();
+            }
+        }
+};
+
+
+/**
+ * @brief Counters of one producer thread, see QuickLogger::metrics.
+ *
+ * Every producer thread owns one cache line aligned slot which only it writes to, so counting
+ * needs no atomic read-modify-write. A thread gives its slot back when it exits and the next
+ * new producer takes it over, continuing its counts and sequence numbers. Producers beyond
+ * QuickLogger::MAX_PRODUCERS live ones share an overflow slot which is counted with atomic
+ * increments instead.
+ *
+ * Attributes:
+ *  * enqueued
+ *    Logs pushed per level.
+ *  * dropped
+ *    Logs which could not be pushed because the queue did not exist.
+ *  * queued
+ *    Logs pushed per queue, used to compute the queue depths.
+ *  * sequence
+ *    Sequence number of the next Log per queue. Counts dropped Logs too, so the consumer
+ *    sees a gap in the sequence numbers when Logs were lost.
+ */
+class alignas(64) ProducerCounters {
+    public:
+    bool shared = false;
+    int index = -1;
+    std::atomic<bool> owned{false};
+    std::atomic<u_int64_t> enqueued[LOG_TYPES] = {};
+    std::atomic<u_int64_t> dropped{0};
+    std::unique_ptr<std::atomic<u_int64_t>[]> queued;
+    std::unique_ptr<std::atomic<u_int64_t>[]> sequence;
+
+    ProducerCounters(int queues, int slot) : index(slot), queued(new std::atomic<u_int64_t>[queues]), sequence(new std::atomic<u_int64_t>[queues]) {
+        for(int i = 0 ; i < queues ; i++){
+            queued[i].store(0, std::memory_order_relaxed);
+            sequence[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    u_int64_t Next(std::atomic<u_int64_t> &counter){
+        if(shared){
+            return counter.fetch_add(1, std::memory_order_relaxed);
+        }
+        u_int64_t value = counter.load(std::memory_order_relaxed);
+        counter.store(value + 1, std::memory_order_relaxed);
+        return value;
+    }
+
+    void Count(std::atomic<u_int64_t> &counter){
+        if(shared){
+            counter.fetch_add(1, std::memory_order_relaxed);
+        }
+        else{
+            counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+};
+
+/**
+ * @brief Records, bytes and consumer time spent on the Logs of one site or format string.
+ */
+class SiteVolume {
+    public:
+    std::atomic<u_int64_t> records{0};
+    std::atomic<u_int64_t> bytes{0};
+    std::atomic<u_int64_t> ticks{0};
+
+    void Add(u_int64_t lineBytes, u_int64_t lineTicks){
+        records.store(records.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        bytes.store(bytes.load(std::memory_order_relaxed) + lineBytes, std::memory_order_relaxed);
+        ticks.store(ticks.load(std::memory_order_relaxed) + lineTicks, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * @brief Per consumer table of the log volume per call site, see QuickLogger::SiteProfiles.
+ *
+ * Logs made through a registered site are counted per site, all other Logs per format string
+ * (the unformatted value), keyed by its text so that a buffer reused for different messages
+ * counts each of them under its own. At most MAX_FORMATS distinct strings are tracked, further
+ * ones are counted under "<other>" so dynamic messages cannot grow the tables without bound.
+ * Only the owning consumer inserts and counts, so it looks entries up without the lock and
+ * only takes it to insert; readers take the lock to walk the tables.
+ */
+class SiteProfiler {
+    public:
+    static const size_t MAX_FORMATS = 4096;
+
+    std::mutex lock;
+    std::unordered_map<const LogSite*, SiteVolume> sites;
+    std::unordered_map<std::string, SiteVolume> formats;
+
+    /**
+     * @brief Returns the entry the Log is counted in. Must be called before the Log is formatted.
+     */
+    SiteVolume &EntryFor(const Log* log){
+        if(log->site != nullptr){
+            auto it = sites.find(log->site);
+            if(it != sites.end()){
+                return it->second;
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            return sites[log->site];
+        }
+        auto it = formats.find(log->value);
+        if(it != formats.end()){
+            return it->second;
+        }
+        if(formats.size() < MAX_FORMATS){
+            std::lock_guard<std::mutex> guard(lock);
+            return formats[log->value];
+        }
+        if(other == nullptr){
+            std::lock_guard<std::mutex> guard(lock);
+            other = &formats["<other>"];
+        }
+        return *other;
+    }
+
+    private:
+    SiteVolume* other = nullptr;
+};
+
+/**
+ * @brief Log volume of one site or format string, merged over all consumers.
+ *
+ * Attributes:
+ *  * name
+ *    "file:line message" for registered sites, otherwise the format string.
+ *  * records, bytes
+ *    Number of Logs written and bytes of their lines.
+ *  * nanoseconds
+ *    Consumer time spent formatting and writing them.
+ *  * cpuShare, byteShare
+ *    Their share of the consumer time and of the bytes of all profiled Logs.
+ */
+class SiteProfile {
+    public:
+    std::string name;
+    u_int64_t   records = 0;
+    u_int64_t   bytes = 0;
+    u_int64_t   nanoseconds = 0;
+    double      cpuShare = 0;
+    double      byteShare = 0;
+};
+
+
+/**
+ * @brief Counters of one consumer thread, only written by that thread.
+ *
+ * Attributes:
+ *  * written
+ *    Logs written per level.
+ *  * aggregated
+ *    Metrics-only Logs which were aggregated instead of written.
+ *  * dequeued
+ *    Logs popped from the queue of the consumer.
+ *  * bytes
+ *    Bytes of rendered lines written.
+ *  * busyTicks
+ *    TscClock ticks spent handling Logs, the rest of the time the consumer was polling.
+ *  * startTicks
+ *    TscClock reading when the consumer started.
+ *  * backlogAge
+ *    Nanoseconds the last dequeued Log waited in the queue.
+ *  * inFlightTicks
+ *    TscClock enqueue time of the Log from its own queue the consumer is handling, 0 between
+ *    Logs. Read by the watchdog thread to tell the age of the oldest unwritten Log.
+ *  * lost
+ *    Logs found missing from the sequence numbers of the producers.
+ *  * aboveWatermark
+ *    Whether the consumer is above its high watermark, see QuickLogger::setWatermarks.
+ *  * stalled
+ *    Whether the watchdog found the consumer stalled, see QuickLogger::enableWatchdog.
+ *  * polls
+ *    Iterations of the consumer loop, which tell the watchdog a stalled consumer came back
+ *    while the helpers keep its queue empty.
+ *  * helped, helpEpoch
+ *    Logs popped from the queue of the consumer by other consumers while it was stalled,
+ *    and a counter bumped with each of them. Written by the helping consumers.
+ *  * batchSizes
+ *    Number of Logs handled between two polls that found the queue empty.
+ *  * queueWait
+ *    Nanoseconds each Log waited in the queue, from the push to the pop.
+ *  * formatLatency
+ *    Nanoseconds from the pop until the line of each Log was rendered.
+ *  * writeLatency
+ *    Nanoseconds spent writing each line to the files, sinks and STDOUT.
+ *  * endToEnd
+ *    Nanoseconds per level from the push of each Log until its line was handed to the outputs.
+ *  * profiler
+ *    Log volume per call site, only counted while the site profiler is enabled.
+ */
+class alignas(64) ConsumerCounters {
+    public:
+    std::atomic<u_int64_t> written[LOG_TYPES] = {};
+    std::atomic<u_int64_t> aggregated{0};
+    std::atomic<u_int64_t> dequeued{0};
+    std::atomic<u_int64_t> bytes{0};
+    std::atomic<u_int64_t> busyTicks{0};
+    std::atomic<u_int64_t> startTicks{0};
+    std::atomic<u_int64_t> backlogAge{0};
+    std::atomic<u_int64_t> inFlightTicks{0};
+    std::atomic<u_int64_t> lost{0};
+    std::atomic<bool>      aboveWatermark{false};
+    std::atomic<bool>      stalled{false};
+    std::atomic<u_int64_t> polls{0};
+    std::atomic<u_int64_t> helped{0};
+    std::atomic<u_int64_t> helpEpoch{0};
+    Histogram              batchSizes;
+    Histogram              queueWait;
+    Histogram              formatLatency;
+    Histogram              writeLatency;
+    Histogram              endToEnd[LOG_TYPES];
+    SiteProfiler           profiler;
+
+    static void Add(std::atomic<u_int64_t> &counter, u_int64_t value){
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * @brief Queue depth and backlog age thresholds of the consumers, see QuickLogger::setWatermarks.
+ *
+ * A consumer goes above its watermark when its queue depth reaches highDepth or the age of its
+ * oldest unwritten Log reaches highAge, and back below when both are at or under lowDepth
+ * and lowAge again. A high threshold of 0 is not checked.
+ */
+class Watermarks {
+    public:
+    u_int64_t                highDepth = 0;
+    u_int64_t                lowDepth = 0;
+    std::chrono::nanoseconds highAge{0};
+    std::chrono::nanoseconds lowAge{0};
+};
+
+/**
+ * @brief A consumer crossing its high or low watermark.
+ */
+class WatermarkEvent {
+    public:
+    int         consumerID;
+    bool        high;
+    u_int64_t   queueDepth;
+    u_int64_t   backlogAge;
+};
+
+/**
+ * @brief A consumer which stalled or recovered, see QuickLogger::enableWatchdog.
+ */
+class StallEvent {
+    public:
+    int                       consumerID;
+    bool                      stalled;
+    u_int64_t                 queueDepth;
+    std::chrono::milliseconds stalledFor;
+};
+
+/**
+ * @brief Snapshot of the counters of one consumer, see QuickLogger::metrics.
+ */
+class ConsumerMetrics {
+    public:
+    int         consumerID;
+    u_int64_t   written[LOG_TYPES];
+    u_int64_t   aggregated;
+    u_int64_t   bytes;
+    u_int64_t   queueDepth;
+    u_int64_t   backlogAge;
+    u_int64_t   lost;
+    double      busyRatio;
+    u_int64_t   busyNanoseconds;
+    Histogram   batchSizes;
+    Histogram   queueWait;
+    Histogram   formatLatency;
+    Histogram   writeLatency;
+};
+
+/**
+ * @brief Snapshot of the counters of the Logger, aggregated over all producers and consumers.
+ *
+ * endToEnd holds per level the nanoseconds from the push of each Log until its line was
+ * handed to the outputs, merged over all consumers.
+ */
+class LoggerMetrics {
+    public:
+    Histogram   endToEnd[LOG_TYPES];
+    u_int64_t   enqueued[LOG_TYPES] = {};
+    u_int64_t   written[LOG_TYPES] = {};
+    u_int64_t   dropped = 0;
+    u_int64_t   lost = 0;
+    u_int64_t   aggregated = 0;
+    u_int64_t   bytes = 0;
+    std::vector<ConsumerMetrics> consumers;
+};
+
+
+#ifndef QUICK_LOGGER_ENTRIES_PER_NODE
+#define QUICK_LOGGER_ENTRIES_PER_NODE 2048
+#endif
+
+typedef xenium::ramalhete_queue<Log*,xenium::policy::reclaimer<xenium::reclamation::epoch_based<>>,xenium::policy::entries_per_node<QUICK_LOGGER_ENTRIES_PER_NODE>> LogQueue;
+
+
+/**
+ * @brief Implementation of the QuickLogger Class
+ *
+ * The Class implementing all required methods to use the Logger. Implemented as a Singleton.
+ * Working of the Logger is as follows,
+ *    
+ *    The Logger is started using the START_QUICK_LOGGER function. This function initializes the
+ *    singleton object of the QuickLogger and then spawns the consumer threads keeping track of 
+ *    their own Fast Unbounded Lock-Free Multi-Producer Multi-Consumer queues.
+ *    Please note that START_QUICK_LOGGER returns a reference to the Singleton Logger object and
+ *    this is needed going forward. However you can always get the reference back via a call to 
+ *    the method instance().
+ *    
+ *    The Logging is done by calling the class method LogItem. The level of the log, the thread ID
+ *    and the log value and parameters should be passed. Please note that the thread ID indicates 
+ *    which particular queue the log is to be pushed into and hence should be between 0 and 
+ *    processor_count-1. Ideally you should be using as many producer threads as consumer threads.
+ * 
+ *    To stop the Logger, call STOP_QUICK_LOGGER which takes in the reference from earlier.
+ *    This signals the threads to finish up and cleans out all the allocated memory and resets the
+ *    QuickLogger.
+ * 
+ * Attributes:
+ *  * is_stdout
+ *    Stores whether the logger is enabled for logging the values to standard output
+ *    in addition to file output.
+ *  * fileOutput
+ *    Whether the lines are written to the log files, see setFileOutput.
+ *  * outputFormat
+ *    Stores whether the lines are written as plain text or as JSON objects.
+ *  * processor_count
+ *    Stores the number of threads to spawn as consumers. This also decides the number of
+ *    queues that are constructed. When this value is not specified during the construction of
+ *    QuickLogger, it is automatically set equal to the number of cores that the running
+ *    machine has.
+ *  * outputFiles
+ *    Stores the FILE pointers to the LOG_TYPES different log level files.
+ *  * logDirectory
+ *    The directory the log files are written to.
+ *  * initInstanceFlag
+ *    Keeps track of instantiation. Once initialized, cannot do it again, unless the QuickLogger
+ *    is stopped and destroyed.
+ *  * start_flag
+ *    Keeps track of the status of QuickLogger, whether the Logger is running or idle.
+ *  * threadTerminateFlags
+ *    Pointer to an array of atomic flags that are used to signal the threads when the Logger is
+ *    requested to stop.
+ *  * lockFreeQueues
+ *    Vector of pointers to Lock-Free Unbounded MPMC Queues which are used by the threads.
+ *    They are created by StartLogger and deleted by STOP_QUICK_LOGGER.
+ *  * threads
+ *    Vector of the thread objects.
+ *  * sinks
+ *    Additional outputs receiving every formatted Log.
+ *  * metricsRules
+ *    The sites and levels which are aggregated instead of written.
+ *  * metricsInterval
+ *    Interval at which the consumers report the aggregated metrics.
+ *  * metricsCallback
+ *    Receives the metrics reports instead of the log files, if set.
+ *  * producerCounters
+ *    The counter slots of the producer threads, registered on their first Log.
+ *  * consumerCounters
+ *    The counters of the consumer threads.
+ *  * selfReportInterval
+ *    Interval at which consumer 0 writes the Logger metrics to the INFO file, 0 to disable.
+ *  * siteProfiling
+ *    Whether the consumers count the log volume per call site.
+ *  * siteReportInterval, siteReportCount
+ *    Interval at which consumer 0 writes the siteReportCount noisiest sites, 0 to disable.
+ *  * sequenceNumbers
+ *    Whether the lines carry the producer and sequence number of their Log.
+ *  * watermarks, watermarkCallback, watermarkFD
+ *    Thresholds the consumers check their queue against, the callback and the eventfd
+ *    notified when a consumer crosses them.
+ *  * stallTimeout, stallCallback
+ *    Time without progress after which the watchdog declares a consumer stalled, 0 to not
+ *    run the watchdog, and the callback notified about stalls.
+ *  * watchdog, watchdogTerminate
+ *    The watchdog thread, run for the stall detection and the watermarks, and the flag
+ *    stopping it.
+ *  * stalledConsumers
+ *    Number of consumers currently stalled. While it is not 0 new Logs are rerouted to the
+ *    healthy consumers and these help draining the stalled queues.
+ *  * consumersPaused
+ *    While set the consumers leave their queues alone, see pauseConsumers.
+ */
+class QuickLogger {
+
+    private:
+        bool         is_stdout;
+        bool         fileOutput = true;
+        LINE_FORMAT  outputFormat = TEXT_LINES;
+
+        QuickLogger(){};
+        ~QuickLogger() = default;
+
+    public:
+
+        int                 processor_count;
+        std::FILE*          outputFiles[LOG_TYPES];
+        std::filesystem::path logDirectory;
+        bool                initInstanceFlag = true;
+        bool                start_flag = true;
+        std::atomic<bool>*  threadTerminateFlags;
+
+        std::vector<LogQueue*> lockFreeQueues;
+        
+        std::vector<std::thread> threads;
+
+        std::vector<std::shared_ptr<LogSink>> sinks;
+
+        std::vector<MetricsRule>                      metricsRules;
+        std::chrono::milliseconds                     metricsInterval{10000};
+        std::function<void(const MetricsSummary&)>    metricsCallback;
+
+        static constexpr int MAX_PRODUCERS = 256;
+
+        std::atomic<ProducerCounters*>                producerCounters[MAX_PRODUCERS + 1] = {};
+        std::atomic<int>                              producerCount{0};
+        std::atomic<u_int32_t>                        producerGeneration{1};
+        std::vector<std::unique_ptr<ConsumerCounters>> consumerCounters;
+        std::chrono::milliseconds                     selfReportInterval{0};
+        bool                                          siteProfiling = false;
+        std::chrono::milliseconds                     siteReportInterval{0};
+        size_t                                        siteReportCount = 10;
+        bool                                          sequenceNumbers = false;
+        Watermarks                                    watermarks;
+        std::function<void(const WatermarkEvent&)>    watermarkCallback;
+        std::atomic<int>                              watermarkFD{-1};
+        std::chrono::milliseconds                     stallTimeout{0};
+        std::function<void(const StallEvent&)>        stallCallback;
+        std::thread                                   watchdog;
+        std::atomic<bool>                             watchdogTerminate{false};
+        std::atomic<int>                              stalledConsumers{0};
+        std::atomic<bool>                             consumersPaused{false};
+
+        QuickLogger(QuickLogger const&) = delete;
+        void operator=(QuickLogger const&) = delete;
+
+
+        /**
+         * @brief Sets whether lines are written as plain text or as JSON objects.
+         * 
+         * Should be called before the Logger is started. In JSON mode every line is one object
+         * with the time, level, thread and message as keys and the context fields nested
+         * under "context".
+         * 
+         * @param format            The LINE_FORMAT to use
+         * @return                  void
+         */
+        void setOutputFormat(LINE_FORMAT format){
+            outputFormat = format;
+        }
+
+        /**
+         * @brief Sets whether the lines are written to the log files.
+         * 
+         * Without file output the lines only go to the sinks and STDOUT, e.g. to a NullSink
+         * or a MemorySink. The files are still opened and carry the session markers.
+         * 
+         * @param enable            `false` to stop writing to the log files
+         * @return                  void
+         */
+        void setFileOutput(bool enable){
+            fileOutput = enable;
+        }
+
+        /**
+         * @brief Makes the consumers stop taking Logs from their queues until resumeConsumers.
+         * 
+         * Logs keep being queued meanwhile. Can be called before the Logger is started to
+         * fill the queues before any consumer runs, e.g. to measure the consumers alone.
+         * Stopping the Logger still writes every queued Log, and the watchdog does not count
+         * the pause as a stall.
+         * 
+         * @return                  void
+         */
+        void pauseConsumers(){
+            consumersPaused.store(true);
+        }
+
+        /**
+         * @brief Lets the consumers take Logs from their queues again, see pauseConsumers.
+         * 
+         * @return                  void
+         */
+        void resumeConsumers(){
+            consumersPaused.store(false);
+        }
+
+        /**
+         * @brief Adds a sink which receives every Log after it has been formatted.
+         * 
+         * Should be called before the Logger is started. Sinks stay registered when the
+         * Logger is stopped and started again.
+         * 
+         * @param sink              The sink to add
+         * @return                  void
+         */
+        void addSink(std::shared_ptr<LogSink> sink){
+            sinks.push_back(std::move(sink));
+        }
+
+        /**
+         * @brief Marks the sites with the given message as metrics-only.
+         * 
+         * Logs from those sites are not written. Instead the consumers count them and record
+         * the given numeric structured field in a histogram, and report the count, rate and
+         * percentiles every metricsInterval. Should be called before the Logger is started.
+         * 
+         * @param message           The message of the sites, as passed to QUICK_LOG_FIELDS
+         * @param field             Key of the field to record, nullptr for the first numeric field
+         * @return                  void
+         */
+        void AggregateSite(std::string message, const char* field = nullptr){
+            metricsRules.push_back(MetricsRule{std::move(message), -1, field});
+        }
+
+        /**
+         * @brief Marks a whole level as metrics-only, see AggregateSite.
+         * 
+         * Site rules take precedence over level rules.
+         * 
+         * @param level             Log Level
+         * @param field             Key of the field to record, nullptr for the first numeric field
+         * @return                  void
+         */
+        void AggregateLevel(int level, const char* field = nullptr){
+            metricsRules.push_back(MetricsRule{std::string(), level, field});
+        }
+
+        /**
+         * @brief Sets how often and where the aggregated metrics are reported.
+         * 
+         * Without a callback every report is written as a "METRICS" line to the file of the
+         * level it was aggregated for. The callback is invoked from the consumer threads.
+         * 
+         * @param interval          Report interval
+         * @param callback          Receives the reports instead of the log files, if set
+         * @return                  void
+         */
+        void setMetricsReport(std::chrono::milliseconds interval, std::function<void(const MetricsSummary&)> callback = nullptr){
+            metricsInterval = interval;
+            metricsCallback = std::move(callback);
+        }
+
+        /**
+         * @brief The producer slot of a thread, given back when the thread exits.
+         */
+        struct ProducerSlotOwner {
+            QuickLogger*      logger = nullptr;
+            ProducerCounters* slot = nullptr;
+            u_int32_t         generation = 0;
+
+            ~ProducerSlotOwner(){
+                // Slots of an earlier session were freed by ResetProducerCounters.
+                if(slot != nullptr && !slot->shared && logger->producerGeneration.load(std::memory_order_acquire) == generation){
+                    slot->owned.store(false, std::memory_order_release);
+                }
+            }
+        };
+
+        /**
+         * @brief Returns the counter slot of the calling producer thread, registering it first.
+         */
+        ProducerCounters* ProducerSlot(){
+            thread_local ProducerSlotOwner owner;
+            u_int32_t current = producerGeneration.load(std::memory_order_acquire);
+            if(owner.generation == current){
+                return owner.slot;
+            }
+            owner.logger = this;
+            owner.generation = current;
+            owner.slot = AcquireProducerSlot();
+            return owner.slot;
+        }
+
+        /**
+         * @brief Takes over the slot of an exited producer, or registers a new one.
+         *
+         * The acquire on owned pairs with the release of the previous owner, so its plain
+         * stores to the counters are visible before they are continued.
+         */
+        ProducerCounters* AcquireProducerSlot(){
+            int count = std::min(producerCount.load(std::memory_order_acquire), MAX_PRODUCERS);
+            for(int i = 0 ; i < count ; i++){
+                ProducerCounters* slot = producerCounters[i].load(std::memory_order_acquire);
+                bool owned = false;
+                if(slot != nullptr && !slot->owned.load(std::memory_order_relaxed) &&
+                   slot->owned.compare_exchange_strong(owned, true, std::memory_order_acq_rel)){
+                    return slot;
+                }
+            }
+            int index = producerCount.fetch_add(1, std::memory_order_relaxed);
+            if(index < MAX_PRODUCERS){
+                ProducerCounters* slot = new ProducerCounters(processor_count, index);
+                slot->owned.store(true, std::memory_order_relaxed);
+                producerCounters[index].store(slot, std::memory_order_release);
+                return slot;
+            }
+            ProducerCounters* slot = producerCounters[MAX_PRODUCERS].load(std::memory_order_acquire);
+            if(slot == nullptr){
+                ProducerCounters* overflow = new ProducerCounters(processor_count, MAX_PRODUCERS);
+                overflow->shared = true;
+                if(producerCounters[MAX_PRODUCERS].compare_exchange_strong(slot, overflow)){
+                    slot = overflow;
+                }
+                else{
+                    delete overflow;
+                }
+            }
+            return slot;
+        }
+
+        /**
+         * @brief Frees the producer slots. Producers register again on their next Log.
+         * 
+         * Called when the Logger is initialized, while no producer is logging.
+         */
+        void ResetProducerCounters(){
+            producerGeneration.fetch_add(1, std::memory_order_acq_rel);
+            for(int i = 0 ; i <= MAX_PRODUCERS ; i++){
+                delete producerCounters[i].exchange(nullptr);
+            }
+            producerCount.store(0);
+        }
+
+        /**
+         * @brief Pushes a Log into the queue given by threadID and counts it.
+         * 
+         * While the watchdog finds the consumer of that queue stalled, the Log goes to the
+         * queue of the next healthy consumer instead. The Log is deleted and counted as
+         * dropped if the queue does not exist.
+         * 
+         * @return                  `true` if the Log was pushed, otherwise `false`
+         */
+        bool Enqueue(Log* l, int threadID){
+            ProducerCounters* counters = ProducerSlot();
+            if(stalledConsumers.load(std::memory_order_relaxed) > 0){
+                threadID = HealthyQueue(threadID);
+            }
+            if(threadID >= 0 && threadID < (int)lockFreeQueues.size()){
+                l->producer = counters->index;
+                l->sequence = counters->Next(counters->sequence[threadID]);
+            }
+            if(threadID < 0 || threadID >= (int)lockFreeQueues.size() || lockFreeQueues[threadID] == nullptr){
+                counters->Count(counters->dropped);
+                QUICK_LOGGER_PROBE2(drop, l->logLevel, threadID);
+                delete l;
+                return false;
+            }
+            int level = l->logLevel;
+            QUICK_LOGGER_PROBE3(enqueue, level, threadID, l);
+            l->enqueueTicks = TscClock::now();
+            lockFreeQueues[threadID]->push(l);
+            counters->Count(counters->enqueued[level]);
+            counters->Count(counters->queued[threadID]);
+            return true;
+        }
+
+        /**
+         * @brief Returns the queue of the first consumer from threadID on which is not stalled.
+         * 
+         * @param threadID          The queue the Log was meant for
+         * @return                  threadID itself if it is healthy, does not exist, or if every
+         *                          consumer is stalled
+         */
+        int HealthyQueue(int threadID) const {
+            int count = (int)consumerCounters.size();
+            if(threadID < 0 || threadID >= count){
+                return threadID;
+            }
+            for(int i = 0 ; i < count ; i++){
+                int candidate = (threadID + i) % count;
+                if(!consumerCounters[candidate]->stalled.load(std::memory_order_relaxed)){
+                    return candidate;
+                }
+            }
+            return threadID;
+        }
+
+        /**
+         * @brief Returns the number of Logs waiting in the queue of a consumer.
+         */
+        u_int64_t QueueDepth(int threadID) const {
+            u_int64_t queued = 0;
+            int count = std::min(producerCount.load(std::memory_order_relaxed), MAX_PRODUCERS);
+            auto add = [&](int i){
+                ProducerCounters* slot = producerCounters[i].load(std::memory_order_acquire);
+                if(slot != nullptr){
+                    queued += slot->queued[threadID].load(std::memory_order_relaxed);
+                }
+            };
+            for(int i = 0 ; i < count ; i++){
+                add(i);
+            }
+            add(MAX_PRODUCERS);
+            u_int64_t dequeued = consumerCounters[threadID]->dequeued.load(std::memory_order_relaxed) +
+                                 consumerCounters[threadID]->helped.load(std::memory_order_relaxed);
+            return queued > dequeued ? queued - dequeued : 0;
+        }
+
+        /**
+         * @brief Returns a snapshot of the counters of the Logger.
+         * 
+         * The producer and consumer slots are summed up when this is called, so it can be
+         * called from any thread at any time while the Logger is running, but the numbers
+         * of different counters are not taken at exactly the same instant.
+         * 
+         * @return                  The aggregated counters and one entry per consumer
+         */
+        LoggerMetrics metrics() const {
+            LoggerMetrics m;
+            for(int i = 0 ; i <= MAX_PRODUCERS ; i++){
+                ProducerCounters* slot = producerCounters[i].load(std::memory_order_acquire);
+                if(slot == nullptr){
+                    continue;
+                }
+                for(int level = 0 ; level < LOG_TYPES ; level++){
+                    m.enqueued[level] += slot->enqueued[level].load(std::memory_order_relaxed);
+                }
+                m.dropped += slot->dropped.load(std::memory_order_relaxed);
+            }
+
+            u_int64_t now = TscClock::now();
+            for(int i = 0 ; i < (int)consumerCounters.size() ; i++){
+                const ConsumerCounters &c = *consumerCounters[i];
+                ConsumerMetrics cm;
+                cm.consumerID = i;
+                for(int level = 0 ; level < LOG_TYPES ; level++){
+                    cm.written[level] = c.written[level].load(std::memory_order_relaxed);
+                    m.written[level] += cm.written[level];
+                }
+                cm.aggregated = c.aggregated.load(std::memory_order_relaxed);
+                cm.bytes = c.bytes.load(std::memory_order_relaxed);
+                cm.queueDepth = QueueDepth(i);
+                cm.backlogAge = c.backlogAge.load(std::memory_order_relaxed);
+                cm.lost = c.lost.load(std::memory_order_relaxed);
+                u_int64_t start = c.startTicks.load(std::memory_order_relaxed);
+                cm.busyRatio = start != 0 && now > start ? (double)c.busyTicks.load(std::memory_order_relaxed) / (now - start) : 0;
+                cm.busyNanoseconds = TscClock::ToNanoseconds(c.busyTicks.load(std::memory_order_relaxed));
+                cm.batchSizes = c.batchSizes;
+                cm.queueWait = c.queueWait;
+                cm.formatLatency = c.formatLatency;
+                cm.writeLatency = c.writeLatency;
+                for(int level = 0 ; level < LOG_TYPES ; level++){
+                    m.endToEnd[level].merge(c.endToEnd[level]);
+                }
+                m.aggregated += cm.aggregated;
+                m.lost += cm.lost;
+                m.bytes += cm.bytes;
+                m.consumers.push_back(std::move(cm));
+            }
+            return m;
+        }
+
+        /**
+         * @brief Makes consumer 0 write the Logger metrics to the INFO file periodically.
+         * 
+         * @param interval          Report interval, 0 to disable
+         * @return                  void
+         */
+        void enableSelfReport(std::chrono::milliseconds interval){
+            selfReportInterval = interval;
+        }
+
+        /**
+         * @brief Writes a snapshot of the Logger metrics as a line to the INFO file.
+         * 
+         * @param threadID          The ID of the consumer thread writing the line
+         * @return                  void
+         */
+        void ReportSelf(int threadID){
+            LoggerMetrics m = metrics();
+            Log report;
+            report.logLevel = INFO;
+            report.time = std::chrono::system_clock::now();
+            report.value = "LOGGER METRICS";
+            u_int64_t enqueued = 0, written = 0;
+            for(int level = 0 ; level < LOG_TYPES ; level++){
+                enqueued += m.enqueued[level];
+                written += m.written[level];
+            }
+            EncodeField(report.fields, kv("enqueued", enqueued));
+            EncodeField(report.fields, kv("written", written));
+            EncodeField(report.fields, kv("aggregated", m.aggregated));
+            EncodeField(report.fields, kv("dropped", m.dropped));
+            EncodeField(report.fields, kv("lost", m.lost));
+            EncodeField(report.fields, kv("bytes", m.bytes));
+            std::string consumers;
+            for(auto &c : m.consumers){
+                consumers += fmt::format("{}{}: depth={} age_ns={} busy={:.3f} batch_p50={} wait_p99_ns={} format_p99_ns={} write_p99_ns={}",
+                                         consumers.empty() ? "" : "; ", c.consumerID, c.queueDepth, c.backlogAge, c.busyRatio,
+                                         c.batchSizes.percentile(0.5), c.queueWait.percentile(0.99),
+                                         c.formatLatency.percentile(0.99), c.writeLatency.percentile(0.99));
+            }
+            EncodeField(report.fields, kv("consumers", consumers));
+            Histogram endToEnd;
+            for(int level = 0 ; level < LOG_TYPES ; level++){
+                endToEnd.merge(m.endToEnd[level]);
+            }
+            EncodeField(report.fields, kv("e2e_p50_ns", endToEnd.percentile(0.5)));
+            EncodeField(report.fields, kv("e2e_p99_ns", endToEnd.percentile(0.99)));
+            EncodeField(report.fields, kv("e2e_p999_ns", endToEnd.percentile(0.999)));
+            EncodeField(report.fields, kv("e2e_max_ns", endToEnd.max()));
+            const std::string noContext;
+            WriteLine(&report, threadID, RenderLine(&report, fmt::to_string(threadID), noContext, RenderFields(&report)));
+        }
+
+        /**
+         * @brief Sets the queue depth and backlog age watermarks of the consumers.
+         * 
+         * Should be called before the Logger is started. The watchdog thread checks the
+         * watermarks of every consumer periodically, a quarter of highAge but at least every
+         * 100 ms, so the check costs the consumers nothing per Log and still fires while a
+         * consumer is blocked in a write. The callback runs on the watchdog thread.
+         * 
+         * @param limits            The thresholds, the same for every consumer
+         * @param callback          Called when a consumer crosses its high or low watermark, may be empty
+         * @return                  void
+         */
+        void setWatermarks(const Watermarks &limits, std::function<void(const WatermarkEvent&)> callback = nullptr){
+            watermarks = limits;
+            watermarkCallback = std::move(callback);
+        }
+
+        /**
+         * @brief Returns an eventfd which is signalled whenever a consumer crosses a watermark.
+         * 
+         * The descriptor is non blocking and created on the first call. After it becomes
+         * readable, isAboveWatermark tells which consumers are behind.
+         * 
+         * @return                  The eventfd, -1 if it could not be created
+         */
+        int watermarkEventFD(){
+            int fd = watermarkFD.load(std::memory_order_acquire);
+            if(fd < 0){
+                int created = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+                if(created >= 0 && !watermarkFD.compare_exchange_strong(fd, created, std::memory_order_acq_rel)){
+                    close(created);
+                    return fd;
+                }
+                fd = created;
+            }
+            return fd;
+        }
+
+        /**
+         * @brief Returns whether a consumer is above its high watermark.
+         * 
+         * @param threadID          The ID of the consumer, negative for any consumer
+         * @return                  `true` if the consumer is behind
+         */
+        bool isAboveWatermark(int threadID = -1) const {
+            for(int i = 0 ; i < (int)consumerCounters.size() ; i++){
+                if((threadID < 0 || threadID == i) && consumerCounters[i]->aboveWatermark.load(std::memory_order_relaxed)){
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * @brief Compares the queue of a consumer against the watermarks and notifies crossings.
+         * 
+         * @param threadID          The ID of the consumer thread
+         * @param queueDepth        The current depth of its queue
+         * @param backlogAge        Nanoseconds its oldest unwritten Log has been waiting
+         * @return                  void
+         */
+        void CheckWatermarks(int threadID, u_int64_t queueDepth, u_int64_t backlogAge){
+            ConsumerCounters &counters = *consumerCounters[threadID];
+            bool above = counters.aboveWatermark.load(std::memory_order_relaxed);
+            bool high;
+            if(!above){
+                high = (watermarks.highDepth > 0 && queueDepth >= watermarks.highDepth) ||
+                       (watermarks.highAge.count() > 0 && backlogAge >= (u_int64_t)watermarks.highAge.count());
+                if(!high){
+                    return;
+                }
+            }
+            else{
+                high = queueDepth > watermarks.lowDepth || backlogAge > (u_int64_t)watermarks.lowAge.count();
+                if(high){
+                    return;
+                }
+            }
+            counters.aboveWatermark.store(high, std::memory_order_relaxed);
+            if(watermarkCallback){
+                watermarkCallback(WatermarkEvent{threadID, high, queueDepth, backlogAge});
+            }
+            int fd = watermarkFD.load(std::memory_order_acquire);
+            if(fd >= 0){
+                eventfd_write(fd, 1);
+            }
+        }
+
+        /**
+         * @brief Runs a watchdog thread which detects consumers making no progress.
+         * 
+         * Should be called before the Logger is started. A consumer which has Logs waiting
+         * but dequeued none for the timeout, e.g. because it is blocked in a hung write, is
+         * reported as stalled with an ERROR line and the callback. Until it polls its queue
+         * again new Logs meant for it are queued to the healthy consumers, and these drain its
+         * queue whenever their own queue is empty. This only gets around a consumer stuck on
+         * its own, e.g. in a sink or descheduled: an output which blocks every writer, like a
+         * hung log file all consumers share, stalls them all and nothing is rerouted.
+         * 
+         * @param timeout           Time without progress before a consumer counts as stalled, 0 to disable
+         * @param callback          Called from the watchdog thread on stalls and recoveries, may be empty
+         * @return                  void
+         */
+        void enableWatchdog(std::chrono::milliseconds timeout, std::function<void(const StallEvent&)> callback = nullptr){
+            stallTimeout = timeout;
+            stallCallback = std::move(callback);
+        }
+
+        /**
+         * @brief Reports a stalled or recovered consumer through the callback and a line
+         * queued to a healthy consumer.
+         * 
+         * @param event             The stall or recovery
+         * @return                  void
+         */
+        void ReportStall(const StallEvent &event){
+            if(stallCallback){
+                stallCallback(event);
+            }
+            for(int i = 0 ; i < (int)consumerCounters.size() ; i++){
+                if(consumerCounters[i]->stalled.load(std::memory_order_relaxed)){
+                    continue;
+                }
+                Log* l = new Log();
+                l->logLevel = event.stalled ? ERROR : WARN;
+                l->time = std::chrono::system_clock::now();
+                l->value = event.stalled ? "CONSUMER STALLED" : "CONSUMER RECOVERED";
+                l->parameterFlag = false;
+                EncodeField(l->fields, kv("consumer", event.consumerID));
+                EncodeField(l->fields, kv("queue_depth", event.queueDepth));
+                EncodeField(l->fields, kv("stalled_ms", (u_int64_t)event.stalledFor.count()));
+                Enqueue(l, i);
+                return;
+            }
+        }
+
+        /**
+         * @brief The watchdog thread function, see enableWatchdog and setWatermarks.
+         * 
+         * A consumer makes progress when its dequeued count changes. An idle consumer with an
+         * empty queue never counts as stalled. A stalled one recovers by dequeuing again, or,
+         * since its Logs are rerouted and its queue is emptied by the helpers, once it polled
+         * since it was marked and holds no Log of its own.
+         * 
+         * The backlog age checked against the watermarks is the age of the oldest unwritten
+         * Log. While a consumer handles a Log that is the Log it holds, so the age keeps growing
+         * while it is blocked in a write. A consumer which does not dequeue at all, e.g. while
+         * paused, holds none; its backlog is then aged from the first check which found Logs
+         * waiting without progress, which is off by at most one period.
+         */
+        void WatchdogThread(){
+            int count = (int)consumerCounters.size();
+            auto now = std::chrono::steady_clock::now();
+            std::vector<u_int64_t> lastDequeued(count, 0);
+            std::vector<std::chrono::steady_clock::time_point> lastProgress(count, now);
+            std::vector<u_int64_t> backlogDequeued(count, 0);
+            std::vector<std::chrono::steady_clock::time_point> backlogSince(count, now);
+            std::vector<u_int64_t> pollsAtStall(count, 0);
+            bool checkStalls = stallTimeout.count() > 0;
+            bool checkWatermarks = watermarks.highDepth > 0 || watermarks.highAge.count() > 0;
+
+            auto period = std::chrono::milliseconds(100);
+            if(checkStalls){
+                period = std::min(period, stallTimeout / 4);
+            }
+            if(watermarks.highAge.count() > 0){
+                period = std::min(period, std::chrono::duration_cast<std::chrono::milliseconds>(watermarks.highAge / 4));
+            }
+            period = std::max(period, std::chrono::milliseconds(1));
+
+            while(!watchdogTerminate.load(std::memory_order_relaxed)){
+                std::this_thread::sleep_for(period);
+                now = std::chrono::steady_clock::now();
+                for(int i = 0 ; i < count ; i++){
+                    ConsumerCounters &counters = *consumerCounters[i];
+                    u_int64_t dequeued = counters.dequeued.load(std::memory_order_relaxed);
+                    u_int64_t depth = QueueDepth(i);
+
+                    if(checkWatermarks){
+                        u_int64_t inFlight = counters.inFlightTicks.load(std::memory_order_relaxed);
+                        u_int64_t ticks = TscClock::now();
+                        u_int64_t age = 0;
+                        if(depth == 0 || dequeued != backlogDequeued[i]){
+                            backlogDequeued[i] = dequeued;
+                            backlogSince[i] = now;
+                        }
+                        if(inFlight != 0){
+                            age = TscClock::ToNanoseconds(ticks > inFlight ? ticks - inFlight : 0);
+                        }
+                        else if(depth > 0){
+                            age = std::chrono::duration_cast<std::chrono::nanoseconds>(now - backlogSince[i]).count();
+                        }
+                        CheckWatermarks(i, depth, age);
+                    }
+
+                    if(!checkStalls){
+                        continue;
+                    }
+                    bool stalled = counters.stalled.load(std::memory_order_relaxed);
+                    auto stalledFor = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastProgress[i]);
+                    // New Logs go to other consumers and the helpers empty its queue, so a stalled
+                    // consumer which came back dequeues nothing. It recovered once it polled again
+                    // and is not handling a Log of its own.
+                    bool polling = stalled && counters.polls.load(std::memory_order_relaxed) != pollsAtStall[i] &&
+                                   counters.inFlightTicks.load(std::memory_order_relaxed) == 0;
+                    if(dequeued != lastDequeued[i] || (!stalled && depth == 0) || polling || consumersPaused.load(std::memory_order_relaxed)){
+                        lastDequeued[i] = dequeued;
+                        lastProgress[i] = now;
+                        if(stalled){
+                            counters.stalled.store(false, std::memory_order_relaxed);
+                            stalledConsumers.fetch_sub(1, std::memory_order_relaxed);
+                            ReportStall(StallEvent{i, false, depth, stalledFor});
+                        }
+                    }
+                    else if(!stalled && stalledFor >= stallTimeout){
+                        pollsAtStall[i] = counters.polls.load(std::memory_order_relaxed);
+                        counters.stalled.store(true, std::memory_order_relaxed);
+                        stalledConsumers.fetch_add(1, std::memory_order_relaxed);
+                        ReportStall(StallEvent{i, true, depth, stalledFor});
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Pops a Log from the queue of a stalled consumer.
+         * 
+         * @param threadID          The ID of the helping consumer
+         * @param log               Set to the popped Log
+         * @return                  The ID of the queue the Log was popped from, -1 if none
+         */
+        int HelpStalled(int threadID, Log* &log){
+            for(int i = 0 ; i < (int)consumerCounters.size() ; i++){
+                ConsumerCounters &stalled = *consumerCounters[i];
+                if(i == threadID || !stalled.stalled.load(std::memory_order_relaxed)){
+                    continue;
+                }
+                if(lockFreeQueues[i]->try_pop(log)){
+                    // Only successful pops invalidate the sequence checks of the stalled consumer,
+                    // empty polls of idle helpers must not keep writing to its counters.
+                    stalled.helpEpoch.fetch_add(1, std::memory_order_relaxed);
+                    stalled.helped.fetch_add(1, std::memory_order_relaxed);
+                    return i;
+                }
+            }
+            return -1;
+        }
+
+        /**
+         * @brief Makes every line carry the producer slot and sequence number of its Log.
+         * 
+         * Should be called before the Logger is started. The consumers always detect gaps in
+         * the sequence numbers, this lets tools/sequence_check audit the log files offline.
+         * Text lines get a "seq=<producer>:<sequence>" column after the thread ID, JSON lines
+         * "producer" and "seq" keys. Logs aggregated into metrics are not written, so their
+         * numbers are accounted for by "aggregated: N records" lines, see ReportAggregated.
+         * 
+         * @param enable            Whether to write the sequence numbers
+         * @return                  void
+         */
+        void enableSequenceNumbers(bool enable = true){
+            sequenceNumbers = enable;
+        }
+
+        /**
+         * @brief Writes an "aggregated: N records" line to the INFO file per stream with
+         * aggregated Logs, and clears the counts.
+         * 
+         * Aggregated Logs use up sequence numbers without being written. The lines carry the
+         * queue, producer and highest sequence number of the Logs they account for, so
+         * tools/sequence_check does not take them for lost ones.
+         * 
+         * @param threadID          The ID of the consumer thread writing the lines
+         * @param aggregated        Count and highest sequence number per queue and producer
+         * @return                  void
+         */
+        void ReportAggregated(int threadID, std::map<std::pair<int, int>, std::pair<u_int64_t, u_int64_t>> &aggregated){
+            for(auto &entry : aggregated){
+                Log report;
+                report.logLevel = INFO;
+                report.time = std::chrono::system_clock::now();
+                report.value = fmt::format("aggregated: {} records", entry.second.first);
+                EncodeField(report.fields, kv("producer", entry.first.second));
+                EncodeField(report.fields, kv("queue", entry.first.first));
+                EncodeField(report.fields, kv("last_seq", entry.second.second));
+                const std::string noContext;
+                WriteLine(&report, threadID, RenderLine(&report, fmt::to_string(threadID), noContext, RenderFields(&report)));
+            }
+            aggregated.clear();
+        }
+
+        /**
+         * @brief Writes a "gap: N records lost" line to the WARN file and counts the lost Logs.
+         * 
+         * @param threadID          The ID of the consumer thread which found the gap
+         * @param producer          The producer slot the Logs were lost from
+         * @param first             The first missing sequence number
+         * @param count             The number of missing Logs
+         * @return                  void
+         */
+        void ReportGap(int threadID, int producer, u_int64_t first, u_int64_t count){
+            ConsumerCounters::Add(consumerCounters[threadID]->lost, count);
+            Log report;
+            report.logLevel = WARN;
+            report.time = std::chrono::system_clock::now();
+            report.value = fmt::format("gap: {} records lost", count);
+            EncodeField(report.fields, kv("producer", producer));
+            EncodeField(report.fields, kv("queue", threadID));
+            EncodeField(report.fields, kv("first_seq", first));
+            const std::string noContext;
+            WriteLine(&report, threadID, RenderLine(&report, fmt::to_string(threadID), noContext, RenderFields(&report)));
+        }
+
+        /**
+         * @brief Enables counting the records, bytes and consumer time per call site.
+         * 
+         * Should be called before the Logger is started. The profile is available at any time
+         * through SiteProfiles, and with a non zero interval consumer 0 also writes the top
+         * sites as "SITE PROFILE" lines to the INFO file periodically.
+         * 
+         * @param interval          Report interval, 0 to only profile on demand
+         * @param topN              Number of sites in the periodic report
+         * @return                  void
+         */
+        void enableSiteProfiler(std::chrono::milliseconds interval = std::chrono::milliseconds(0), size_t topN = 10){
+            siteProfiling = true;
+            siteReportInterval = interval;
+            siteReportCount = topN;
+        }
+
+        /**
+         * @brief Returns the noisiest call sites, by bytes written, merged over all consumers.
+         * 
+         * @param topN              Maximum number of sites returned, 0 for all
+         * @return                  The sites ordered by bytes, largest first
+         */
+        std::vector<SiteProfile> SiteProfiles(size_t topN = 10) const {
+            std::unordered_map<std::string, SiteProfile> merged;
+            u_int64_t totalTicks = 0, totalBytes = 0;
+            auto add = [&](const std::string &name, const SiteVolume &volume){
+                SiteProfile &p = merged[name];
+                p.name = name;
+                p.records += volume.records.load(std::memory_order_relaxed);
+                p.bytes += volume.bytes.load(std::memory_order_relaxed);
+                u_int64_t ticks = volume.ticks.load(std::memory_order_relaxed);
+                p.nanoseconds += TscClock::ToNanoseconds(ticks);
+                totalTicks += ticks;
+                totalBytes += volume.bytes.load(std::memory_order_relaxed);
+            };
+            for(auto &counters : consumerCounters){
+                SiteProfiler &profiler = counters->profiler;
+                std::lock_guard<std::mutex> guard(profiler.lock);
+                for(auto &entry : profiler.sites){
+                    add(fmt::format("{}:{} {}", entry.first->file, entry.first->line, entry.first->message), entry.second);
+                }
+                for(auto &entry : profiler.formats){
+                    add(entry.first, entry.second);
+                }
+            }
+
+            std::vector<SiteProfile> profiles;
+            u_int64_t totalNanoseconds = TscClock::ToNanoseconds(totalTicks);
+            for(auto &entry : merged){
+                SiteProfile &p = entry.second;
+                p.cpuShare = totalNanoseconds > 0 ? (double)p.nanoseconds / totalNanoseconds : 0;
+                p.byteShare = totalBytes > 0 ? (double)p.bytes / totalBytes : 0;
+                profiles.push_back(std::move(p));
+            }
+            std::sort(profiles.begin(), profiles.end(), [](const SiteProfile &a, const SiteProfile &b){ return a.bytes > b.bytes; });
+            if(topN > 0 && profiles.size() > topN){
+                profiles.resize(topN);
+            }
+            return profiles;
+        }
+
+        /**
+         * @brief Writes the siteReportCount noisiest sites as lines to the INFO file.
+         * 
+         * @param threadID          The ID of the consumer thread writing the lines
+         * @return                  void
+         */
+        void ReportSites(int threadID){
+            std::string id = fmt::to_string(threadID);
+            const std::string noContext;
+            int rank = 0;
+            for(auto &profile : SiteProfiles(siteReportCount)){
+                Log report;
+                report.logLevel = INFO;
+                report.time = std::chrono::system_clock::now();
+                report.value = "SITE PROFILE";
+                EncodeField(report.fields, kv("rank", ++rank));
+                EncodeField(report.fields, kv("records", profile.records));
+                EncodeField(report.fields, kv("bytes", profile.bytes));
+                EncodeField(report.fields, kv("byte_share", std::round(profile.byteShare * 10000) / 10000));
+                EncodeField(report.fields, kv("cpu_share", std::round(profile.cpuShare * 10000) / 10000));
+                EncodeField(report.fields, kv("site", profile.name));
+                WriteLine(&report, threadID, RenderLine(&report, id, noContext, RenderFields(&report)));
+            }
+        }
+
+        /**
+         * @brief Writes a rendered line to the log file of its level, the sinks and STDOUT.
+         * 
+         * @param log               Pointer to the Log
+         * @param threadID          The ID of the consumer thread
+         * @param logMessage        The rendered line
+         * @return                  void
+         */
+        void WriteLine(const Log* log, int threadID, const std::string &logMessage){
+            if(fileOutput){
+                fmt::print(outputFiles[log->logLevel], "{}", logMessage);
+            }
+
+            for(auto &sink : sinks){
+                sink->write(log, threadID, logMessage);
+            }
+
+            if(is_stdout){
+                switch (log->logLevel)
+                {
+                case ERROR:
+                    fmt::print(fmt::fg(fmt::color::red) | fmt::bg(fmt::color::yellow), "{}", logMessage);
+                    break;
+                case WARN:
+                    fmt::print(fmt::fg(fmt::color::yellow), "{}", logMessage);
+                    break;
+                case FAULT:
+                    fmt::print(fmt::fg(fmt::color::orange), "{}", logMessage);
+                    break;
+                case INFO:
+                    fmt::print(fmt::fg(fmt::color::aqua), "{}", logMessage);
+                    break;
+                case DEBUG:
+                    fmt::print(fmt::fg(fmt::color::green), "{}", logMessage);
+                    break;
+                case TRACE:
+                    fmt::print(fmt::fg(fmt::color::hot_pink), "{}", logMessage);
+                    break;
+                
+                default:
+                    fmt::print(fmt::fg(fmt::color::antique_white), "{}", logMessage);
+                    break;
+                }
+            }
+        }
 
-/**
- * @brief Implementation of the QuickLogger Class
- *
- * The Class implementing all required methods to use the Logger. Implemented as a Singleton.
- * Working of the Logger is as follows,
- *    
- *    The Logger is started using the START_QUICK_LOGGER function. This function initializes the
- *    singleton object of the QuickLogger and then spawns the consumer threads keeping track of 
- *    their own Fast Unbounded Lock-Free Multi-Producer Multi-Consumer queues.
- *    Please note that START_QUICK_LOGGER returns a reference to the Singleton Logger object and
- *    this is needed going forward. However you can always get the reference back via a call to 
- *    the method instance().
- *    
- *    The Logging is done by calling the class method LogItem. The level of the log, the thread ID
- *    and the log value and parameters should be passed. Please note that the thread ID indicates 
- *    which particular queue the log is to be pushed into and hence should be between 0 and 
- *    processor_count-1. Ideally you should be using as many producer threads as consumer threads.
- * 
- *    To stop the Logger, call STOP_QUICK_LOGGER which takes in the reference from earlier.
- *    This signals the threads to finish up and cleans out all the allocated memory and resets the
- *    QuickLogger.
- * 
- * Attributes:
- *  * is_stdout
- *    Stores whether the logger is enabled for logging the values to standard output
- *    in addition to file output.
- *  * processor_count
- *    Stores the number of threads to spawn as consumers. This also decides the number of
- *    queues that are constructed. When this value is not specified during the construction of
- *    QuickLogger, it is automatically set equal to the number of cores that the running
- *    machine has.
- *  * outputFiles
- *    Stores the FILE pointers to the LOG_TYPES different log level files.
- *  * initInstanceFlag
- *    Keeps track of instantiation. Once initialized, cannot do it again, unless the QuickLogger
- *    is stopped and destroyed.
- *  * start_flag
- *    Keeps track of the status of QuickLogger, whether the Logger is running or idle.
- *  * threadTerminateFlags
- *    Pointer to an array of atomic flags that are used to signal the threads when the Logger is
- *    requested to stop.
- *  * lockFreeQueues
- *    Vector of pointers to Lock-Free Unbounded MPMC Queues which are used by the threads.
- *  * threads
- *    Vector of the thread objects.
- */
-class QuickLogger {
+        /**
+         * @brief Reports the metrics aggregated by a consumer, to the callback or the log files.
+         * 
+         * @param aggregator        The aggregator of the consumer
+         * @param threadID          The ID of the consumer thread
+         * @return                  void
+         */
+        void ReportMetrics(MetricsAggregator &aggregator, int threadID){
+            std::string id = fmt::to_string(threadID);
+            const std::string noContext;
+            aggregator.Report(threadID, [&](const MetricsSummary &summary){
+                if(metricsCallback){
+                    metricsCallback(summary);
+                    return;
+                }
+                const Histogram &h = summary.histogram;
+                Log report;
+                report.logLevel = summary.level;
+                report.time = std::chrono::system_clock::now();
+                report.value = "METRICS " + summary.name;
+                double rate = std::round(summary.rate * 100) / 100;
+                EncodeField(report.fields, kv("count", summary.count));
+                EncodeField(report.fields, kv("rate", rate));
+                if(h.count() > 0){
+                    if(!summary.field.empty()){
+                        EncodeField(report.fields, kv("field", summary.field));
+                    }
+                    EncodeField(report.fields, kv("min", h.min()));
+                    EncodeField(report.fields, kv("p50", h.percentile(0.5)));
+                    EncodeField(report.fields, kv("p90", h.percentile(0.9)));
+                    EncodeField(report.fields, kv("p99", h.percentile(0.99)));
+                    EncodeField(report.fields, kv("p999", h.percentile(0.999)));
+                    EncodeField(report.fields, kv("max", h.max()));
+                }
+                WriteLine(&report, threadID, RenderLine(&report, id, noContext, RenderFields(&report)));
+            });
+        }
 
-    private:
-        bool         is_stdout;
+#ifdef QUICK_LOGGER_FUNCTION_TRACE
+        /**
+         * @brief Drains the function trace rings assigned to a consumer into its trace file.
+         * 
+         * Ring i is drained by consumer i % processor_count into FUNCTIONS_<consumer>.trace.
+         * The file is a sequence of chunks: a header chunk {1, version, nanoseconds per tick,
+         * runtime address of __cyg_profile_func_enter} written when the file is opened, used
+         * by tools/function_trace to symbolize the addresses, and event chunks {2, thread,
+         * count, 0, dropped so far} followed by count FunctionEvents.
+         * 
+         * @param threadID          The ID of the consumer thread
+         * @param file              The trace file of the consumer, opened on first use
+         * @param events            Scratch buffer for the drained events
+         * @return                  void
+         */
+        void DrainFunctionTrace(int threadID, std::FILE* &file, std::vector<FunctionEvent> &events){
+            int count = std::min(FunctionTraceRegistry::Count().load(), FunctionTraceRegistry::MAX_THREADS);
+            for(int i = threadID ; i < count ; i += processor_count){
+                FunctionTraceRing* ring = FunctionTraceRegistry::Rings()[i].load(std::memory_order_acquire);
+                if(ring == nullptr){
+                    continue;
+                }
+                events.clear();
+                if(ring->drain(events) == 0){
+                    continue;
+                }
+                if(file == nullptr){
+                    file = std::fopen((logDirectory / ("FUNCTIONS_" + std::to_string(threadID) + ".trace")).c_str(), "ab");
+                    if(file == nullptr){
+                        return;
+                    }
+                    u_int32_t header[2] = {1, 1};
+                    double nanosecondsPerTick = TscClock::NanosecondsPerTick();
+                    u_int64_t reference = (u_int64_t)(uintptr_t)&__cyg_profile_func_enter;
+                    std::fwrite(header, sizeof(header), 1, file);
+                    std::fwrite(&nanosecondsPerTick, sizeof(nanosecondsPerTick), 1, file);
+                    std::fwrite(&reference, sizeof(reference), 1, file);
+                }
+                u_int32_t chunk[4] = {2, ring->thread, (u_int32_t)events.size(), 0};
+                u_int64_t dropped = ring->dropped.load(std::memory_order_relaxed);
+                std::fwrite(chunk, sizeof(chunk), 1, file);
+                std::fwrite(&dropped, sizeof(dropped), 1, file);
+                std::fwrite(events.data(), sizeof(FunctionEvent), events.size(), file);
+            }
+        }
+#endif
 
-        QuickLogger(){};
-        ~QuickLogger() = default;
+        /**
+         * @brief Formats the time of the Log as "year-month-day hour:minute:second.nanoseconds"
+         * 
+         * @param log               Pointer to the Log
+         * @return                  The formatted time
+         */
+        static std::string FormatTime(const Log* log){
+            using namespace date;
+            using namespace std::chrono;
+
+            auto sd = floor<days>(log->time);
+            // Create time_of_day
+            auto tod = date::make_time(log->time - sd);
+            // Create year_month_day
+            year_month_day ymd = sd;
+
+            // Extract field types as int
+            int y = int{ymd.year()}; // Note 1
+            int m = unsigned{ymd.month()};
+            int d = unsigned{ymd.day()};
+            int h = tod.hours().count();
+            int M = tod.minutes().count();
+            int s = tod.seconds().count();
+            int ns = duration_cast<nanoseconds>(tod.subseconds()).count();
+            
+            return fmt::format("{}-{}-{} {}:{}:{}.{}", y, m, d, h, M, s, ns);
+        }
 
-    public:
+        /**
+         * @brief Renders the context block of a Log in the current output format.
+         * 
+         * Text mode renders "key=value" pairs separated by spaces, JSON mode renders a
+         * ',"context":{"key":"value",...}' member ready to be spliced into the line object, so
+         * the keys cannot collide with the built-in ones.
+         * 
+         * @param block             The context block
+         * @return                  The rendered fields
+         */
+        std::string RenderContext(const ContextBlock &block) const {
+            std::string out;
+            for(auto &field : block.fields){
+                if(outputFormat == JSON_LINES){
+                    out += out.empty() ? ",\"context\":{" : ",";
+                    AppendJSONString(out, field.first);
+                    out += ':';
+                    AppendJSONString(out, field.second);
+                }
+                else{
+                    if(!out.empty()){
+                        out += ' ';
+                    }
+                    out += field.first + "=" + field.second;
+                }
+            }
+            if(outputFormat == JSON_LINES && !out.empty()){
+                out += '}';
+            }
+            return out;
+        }
 
-        int                 processor_count;
-        std::FILE*          outputFiles[LOG_TYPES];
-        bool                initInstanceFlag = true;
-        bool                start_flag = true;
-        std::atomic<bool>*  threadTerminateFlags;
+        /**
+         * @brief Renders the structured fields of a Log in the current output format.
+         * 
+         * Text mode renders "key=value" pairs separated by spaces, quoting strings which
+         * contain spaces, quotes or '='. JSON mode renders ',"key":value' members.
+         * 
+         * @param log               Pointer to the Log
+         * @return                  The rendered fields
+         */
+        std::string RenderFields(const Log* log) const {
+            std::string out;
+            bool json = outputFormat == JSON_LINES;
+            ForEachField(log->fields, [&](const FieldView &field){
+                if(json){
+                    out += ',';
+                    AppendJSONString(out, field.key);
+                    out += ':';
+                }
+                else{
+                    if(!out.empty()){
+                        out += ' ';
+                    }
+                    out += field.key;
+                    out += '=';
+                }
+                switch (field.type)
+                {
+                case FIELD_BOOL:
+                    out += field.b ? "true" : "false";
+                    break;
+                case FIELD_INT:
+                    fmt::format_to(std::back_inserter(out), "{}", field.i);
+                    break;
+                case FIELD_UINT:
+                    fmt::format_to(std::back_inserter(out), "{}", field.u);
+                    break;
+                case FIELD_DOUBLE:
+                    if(json && !std::isfinite(field.d)){
+                        out += "null";
+                    }
+                    else{
+                        fmt::format_to(std::back_inserter(out), "{}", field.d);
+                    }
+                    break;
+                default:
+                    if(json || field.text.empty() || field.text.find_first_of(" \t\"=") != std::string_view::npos){
+                        AppendJSONString(out, field.text);
+                    }
+                    else{
+                        out += field.text;
+                    }
+                    break;
+                }
+            });
+            return out;
+        }
 
-        std::vector<xenium::ramalhete_queue<Log*,xenium::policy::reclaimer<xenium::reclamation::epoch_based<>>,xenium::policy::entries_per_node<2048>>*> lockFreeQueues;
-        
-        std::vector<std::thread> threads;
+        /**
+         * @brief Assembles the complete output line of a formatted Log.
+         * 
+         * @param log               Pointer to the Log, its value must already be formatted
+         * @param id                The ID of the consumer thread as a string
+         * @param context           The rendered context fields of the Log, may be empty
+         * @param fields            The rendered structured fields of the Log, may be empty
+         * @return                  The line including the trailing newline
+         */
+        std::string RenderLine(const Log* log, const std::string &id, const std::string &context, const std::string &fields) const {
+            std::string time = FormatTime(log);
+
+            if(outputFormat == JSON_LINES){
+                std::string line = "{\"time\":";
+                AppendJSONString(line, time);
+                line += ",\"level\":";
+                AppendJSONString(line, logLevelMessages[log->logLevel]);
+                line += ",\"thread\":" + id;
+                if(sequenceNumbers && log->producer >= 0){
+                    line += ",\"producer\":" + fmt::to_string(log->producer) + ",\"seq\":" + fmt::to_string(log->sequence);
+                }
+                if(log->span.valid()){
+                    line += ",\"trace_id\":\"" + ToHex(log->span.traceID) + "\",\"span_id\":\"" + ToHex(log->span.spanID) + "\"";
+                }
+                line += ",\"message\":";
+                AppendJSONString(line, log->value);
+                line += fields;
+                line += context;
+                line += "}\n";
+                return line;
+            }
 
-        QuickLogger(QuickLogger const&) = delete;
-        void operator=(QuickLogger const&) = delete;
+            std::string line = time + "\t\tThread ID : " + id + "\t";
+            if(sequenceNumbers && log->producer >= 0){
+                line += "seq=" + fmt::to_string(log->producer) + ":" + fmt::to_string(log->sequence) + "\t";
+            }
+            if(log->span.valid()){
+                line += "trace=" + ToHex(log->span.traceID) + " span=" + ToHex(log->span.spanID) + "\t";
+            }
+            if(!context.empty()){
+                line += context + "\t";
+            }
+            line += log->value;
+            if(!fields.empty()){
+                line += ' ' + fields;
+            }
+            line += '\n';
+            return line;
+        }
 
 
         /**
@@ -190,6 +3189,11 @@ class QuickLogger {
             }
 
             lockFreeQueues.resize(processor_count);
+            ResetProducerCounters();
+            consumerCounters.clear();
+            for(int i = 0 ; i < processor_count ; i++){
+                consumerCounters.emplace_back(new ConsumerCounters());
+            }
             for(int i = 0 ; i < processor_count ; i++){
                 lockFreeQueues[i] = nullptr;
             }
@@ -209,6 +3213,7 @@ class QuickLogger {
             if(!std::filesystem::is_directory(p/"logs")){
                 std::filesystem::create_directory((p / "logs").string());
             }
+            logDirectory = p / "logs";
             
             for(int i = 0 ; i < LOG_TYPES ; i++){
                 outputFiles[i] = std::fopen( (p / "logs" / (logLevelMessages[i] + ".log")).c_str(), "a" );
@@ -247,9 +3252,7 @@ class QuickLogger {
          */
         void consumerThread( int threadID, int cpu){
             
-            xenium::ramalhete_queue<Log*,xenium::policy::reclaimer<xenium::reclamation::epoch_based<>>,xenium::policy::entries_per_node<2048>>* myqueue = new xenium::ramalhete_queue<Log*,xenium::policy::reclaimer<xenium::reclamation::epoch_based<>>,xenium::policy::entries_per_node<2048>>();
-
-            lockFreeQueues[threadID] = myqueue;
+            LogQueue* myqueue = lockFreeQueues[threadID];
             
             std::string id = fmt::to_string(threadID);
 
@@ -262,77 +3265,212 @@ class QuickLogger {
 
             Log* newlog =  NULL;
 
+            u_int64_t         contextVersion = 0;
+            std::string       contextText;
+            const std::string noContext;
+
+            MetricsAggregator aggregator(metricsRules);
+            auto nextReport = std::chrono::steady_clock::now() + metricsInterval;
+            auto nextSelfReport = std::chrono::steady_clock::now() + selfReportInterval;
+            auto nextSiteReport = std::chrono::steady_clock::now() + siteReportInterval;
+            unsigned int sinceCheck = 0;
+
+            ConsumerCounters &counters = *consumerCounters[threadID];
+            counters.startTicks.store(TscClock::now(), std::memory_order_relaxed);
+            u_int64_t batch = 0;
+
+        #ifdef QUICK_LOGGER_FUNCTION_TRACE
+            std::FILE* functionTrace = nullptr;
+            std::vector<FunctionEvent> functionEvents;
+            u_int64_t functionDrainTicks = (u_int64_t)(QUICK_LOGGER_FUNCTION_TRACE_DRAIN_US * 1000.0 / TscClock::NanosecondsPerTick());
+            u_int64_t nextFunctionDrain = TscClock::now() + functionDrainTicks;
+            u_int64_t functionDrainRequests = 0;
+        #endif
+
+            // Next expected sequence number per producer slot. The overflow slot is shared by
+            // several threads whose Logs can overtake each other, so it is not checked.
+            // Logs popped by helpers can make the sequence jump, so after they helped the
+            // expected numbers are unknown until the next Log of each producer.
+            const u_int64_t UNKNOWN = ~(u_int64_t)0;
+            std::vector<u_int64_t> expected(MAX_PRODUCERS, 0);
+            u_int64_t helpEpoch = 0;
+            // Aggregated Logs per queue and producer since they were last reported, only kept
+            // while the lines carry sequence numbers.
+            std::map<std::pair<int, int>, std::pair<u_int64_t, u_int64_t>> aggregatedSequences;
+
             bool pop_status = false;
 
-            while( (pop_status = myqueue->try_pop(std::ref(newlog))) || !threadTerminateFlags[threadID] ){
+            // The flag is read before the pop, so every Log pushed before STOP_QUICK_LOGGER set it
+            // is still written.
+            while(true){
+                ConsumerCounters::Add(counters.polls, 1);
+                bool terminating = threadTerminateFlags[threadID];
+                if(!terminating && consumersPaused.load(std::memory_order_relaxed)){
+                    std::this_thread::yield();
+                    continue;
+                }
+                int source = threadID;
+                pop_status = myqueue->try_pop(std::ref(newlog));
+                if(!pop_status && stalledConsumers.load(std::memory_order_relaxed) > 0){
+                    source = HelpStalled(threadID, newlog);
+                    pop_status = source >= 0;
+                }
+                if(!pop_status && terminating){
+                    break;
+                }
+
+                if(++sinceCheck >= 1024){
+                    sinceCheck = 0;
+                    if(!aggregator.empty() && std::chrono::steady_clock::now() >= nextReport){
+                        ReportMetrics(aggregator, threadID);
+                        ReportAggregated(threadID, aggregatedSequences);
+                        nextReport += metricsInterval;
+                    }
+                    if(threadID == 0 && selfReportInterval.count() > 0 && std::chrono::steady_clock::now() >= nextSelfReport){
+                        ReportSelf(threadID);
+                        nextSelfReport += selfReportInterval;
+                    }
+                    if(threadID == 0 && siteReportInterval.count() > 0 && std::chrono::steady_clock::now() >= nextSiteReport){
+                        ReportSites(threadID);
+                        nextSiteReport += siteReportInterval;
+                    }
+                }
+
+            #ifdef QUICK_LOGGER_FUNCTION_TRACE
+                // On time rather than on the poll count, so the rings are also drained under load.
+                u_int64_t requests = FunctionTraceRing::DrainRequests().load(std::memory_order_relaxed);
+                if(requests != functionDrainRequests || TscClock::now() >= nextFunctionDrain){
+                    functionDrainRequests = requests;
+                    nextFunctionDrain = TscClock::now() + functionDrainTicks;
+                    DrainFunctionTrace(threadID, functionTrace, functionEvents);
+                }
+            #endif
+
+                if(!pop_status){
+                    if(batch > 0){
+                        counters.batchSizes.record(batch);
+                        batch = 0;
+                    }
+                    continue;
+                }
+
+                u_int64_t popTicks = TscClock::now();
+                batch++;
+                u_int64_t enqueueTicks = newlog->enqueueTicks;
+                if(source == threadID){
+                    counters.inFlightTicks.store(enqueueTicks, std::memory_order_relaxed);
+                    ConsumerCounters::Add(counters.dequeued, 1);
+                }
+                u_int64_t waited = TscClock::ToNanoseconds(popTicks > enqueueTicks ? popTicks - enqueueTicks : 0);
+                counters.backlogAge.store(waited, std::memory_order_relaxed);
+                counters.queueWait.record(waited);
+                QUICK_LOGGER_PROBE4(dequeue, threadID, newlog->logLevel, newlog, waited);
+
+                if(source == threadID && counters.helpEpoch.load(std::memory_order_relaxed) != helpEpoch){
+                    helpEpoch = counters.helpEpoch.load(std::memory_order_relaxed);
+                    std::fill(expected.begin(), expected.end(), UNKNOWN);
+                }
+                if(source == threadID && newlog->producer >= 0 && newlog->producer < MAX_PRODUCERS){
+                    u_int64_t &next = expected[newlog->producer];
+                    if(next == UNKNOWN){
+                        next = newlog->sequence;
+                    }
+                    if(newlog->sequence > next){
+                        ReportGap(threadID, newlog->producer, next, newlog->sequence - next);
+                    }
+                    if(newlog->sequence >= next){
+                        next = newlog->sequence + 1;
+                    }
+                }
+
+                int64_t duration = -1;
+                if(newlog->kind == TIMER_LOG){
+                    duration = TscClock::ToNanoseconds(newlog->tscEnd - newlog->tscBegin);
+                }
+
+                if(aggregator.Aggregate(newlog, duration)){
+                    if(sequenceNumbers && newlog->producer >= 0){
+                        auto &entry = aggregatedSequences[{source, newlog->producer}];
+                        entry.first++;
+                        entry.second = std::max(entry.second, newlog->sequence);
+                    }
+                    delete newlog;
+                    newlog = NULL;
+                    counters.inFlightTicks.store(0, std::memory_order_relaxed);
+                    ConsumerCounters::Add(counters.aggregated, 1);
+                    ConsumerCounters::Add(counters.busyTicks, TscClock::now() - popTicks);
+                    continue;
+                }
+
+                if(newlog->kind == TIMER_LOG){
+                    newlog->time = TscClock::ToTimePoint(newlog->tscBegin);
+                    EncodeField(newlog->fields, kv("duration_ns", duration));
+                }
 
-                if(!pop_status)
-                continue;
+                SiteVolume* volume = siteProfiling ? &counters.profiler.EntryFor(newlog) : nullptr;
 
                 if(newlog->parameterFlag){
                     newlog->saved_op(newlog);
                 }
 
-                using namespace date;
-                using namespace std::chrono;
+                if(newlog->context && newlog->context->version != contextVersion){
+                    contextVersion = newlog->context->version;
+                    contextText = RenderContext(*newlog->context);
+                }
 
-                auto sd = floor<days>(newlog->time);
-                // Create time_of_day
-                auto tod = date::make_time(newlog->time - sd);
-                // Create year_month_day
-                year_month_day ymd = sd;
+                if(newlog->site != nullptr && newlog->value.empty()){
+                    newlog->value = newlog->site->message;
+                }
 
-                // Extract field types as int
-                int y = int{ymd.year()}; // Note 1
-                int m = unsigned{ymd.month()};
-                int d = unsigned{ymd.day()};
-                int h = tod.hours().count();
-                int M = tod.minutes().count();
-                int s = tod.seconds().count();
-                int ns = duration_cast<nanoseconds>(tod.subseconds()).count();
-                
-                std::string time = fmt::format("{}-{}-{} {}:{}:{}.{}\t", y, m, d, h, M, s, ns);
+                std::string logMessage = RenderLine(newlog, source == threadID ? id : fmt::to_string(source), newlog->context ? contextText : noContext,
+                                                    newlog->fields.empty() ? noContext : RenderFields(newlog));
 
-                std::string logMessage =  time + "\tThread ID : " + id + "\t" + newlog->value + "\n"; 
+                u_int64_t handoffTicks = TscClock::now();
+                QUICK_LOGGER_PROBE4(format_done, threadID, newlog->logLevel, newlog, logMessage.size());
+                counters.formatLatency.record(TscClock::ToNanoseconds(handoffTicks - popTicks));
+                counters.endToEnd[newlog->logLevel].record(TscClock::ToNanoseconds(handoffTicks > enqueueTicks ? handoffTicks - enqueueTicks : 0));
                 
-                fmt::print(outputFiles[newlog->logLevel], logMessage);
-
-                if(is_stdout){
-                    switch (newlog->logLevel)
-                    {
-                    case ERROR:
-                        fmt::print(fmt::fg(fmt::color::red) | fmt::bg(fmt::color::yellow), logMessage);
-                        break;
-                    case WARN:
-                        fmt::print(fmt::fg(fmt::color::yellow), logMessage);
-                        break;
-                    case FAULT:
-                        fmt::print(fmt::fg(fmt::color::orange), logMessage);
-                        break;
-                    case INFO:
-                        fmt::print(fmt::fg(fmt::color::aqua), logMessage);
-                        break;
-                    case DEBUG:
-                        fmt::print(fmt::fg(fmt::color::green), logMessage);
-                        break;
-                    case TRACE:
-                        fmt::print(fmt::fg(fmt::color::hot_pink), logMessage);
-                        break;
-                    
-                    default:
-                        fmt::print(fmt::fg(fmt::color::antique_white), logMessage);
-                        break;
-                    }
+                WriteLine(newlog, threadID, logMessage);
+
+                u_int64_t doneTicks = TscClock::now();
+                counters.inFlightTicks.store(0, std::memory_order_relaxed);
+                ConsumerCounters::Add(counters.written[newlog->logLevel], 1);
+                ConsumerCounters::Add(counters.bytes, logMessage.size());
+                ConsumerCounters::Add(counters.busyTicks, doneTicks - popTicks);
+                counters.writeLatency.record(TscClock::ToNanoseconds(doneTicks - handoffTicks));
+                QUICK_LOGGER_PROBE5(write_done, threadID, newlog->logLevel, newlog, logMessage.size(), TscClock::ToNanoseconds(doneTicks - handoffTicks));
+                if(volume != nullptr){
+                    volume->Add(logMessage.size(), doneTicks - popTicks);
                 }
 
                 if(pop_status){
-                    free(newlog);
+                    delete newlog;
                     newlog = NULL;
                 }
             }
 
-            lockFreeQueues[threadID] = nullptr;
-            free(myqueue);
+            // Logs sent after the queue was drained for the last time are lost.
+            int producers = std::min(producerCount.load(std::memory_order_relaxed), MAX_PRODUCERS);
+            for(int i = 0 ; i < producers ; i++){
+                ProducerCounters* slot = producerCounters[i].load(std::memory_order_acquire);
+                u_int64_t sent = slot != nullptr ? slot->sequence[threadID].load(std::memory_order_relaxed) : 0;
+                if(expected[i] != UNKNOWN && sent > expected[i]){
+                    ReportGap(threadID, i, expected[i], sent - expected[i]);
+                }
+            }
+
+            if(!aggregator.empty()){
+                ReportMetrics(aggregator, threadID);
+            }
+            ReportAggregated(threadID, aggregatedSequences);
+
+        #ifdef QUICK_LOGGER_FUNCTION_TRACE
+            DrainFunctionTrace(threadID, functionTrace, functionEvents);
+            if(functionTrace != nullptr){
+                fclose(functionTrace);
+            }
+        #endif
+
             return;
         }
 
@@ -340,27 +3478,28 @@ class QuickLogger {
         /**
          * @brief Starts the Logger
          * 
-         * Spawns the consumer threads, and only returns when all the threads have been spawned
-         * and their queues have been initialized.
+         * Creates the queues and spawns the consumer threads, so Logs can be queued as soon as
+         * this returns.
          */
         void StartLogger(){
             if(threads.size() == processor_count){
                 std::cerr<<"ERROR\t:\tMax Threads already created and running\n";
             }
+            TscClock::Calibrate();
+
             int TOT_TRDS = processor_count == 1 ? 1 : processor_count/2;
             int copy = processor_count;
+            for(int i = 0 ; i < copy ; i++){
+                lockFreeQueues[i] = new LogQueue();
+            }
             for(int i = 0 ; i < copy ; i++){
                 int temp = (i%TOT_TRDS)+1;
                 threads.push_back(std::thread(&QuickLogger::consumerThread, this, i, temp));
             }
-
-            while(true){
-                bool checkflag = true;
-                for(int i = 0 ; i < copy ; i++){
-                    checkflag &= (lockFreeQueues[i] != nullptr);
-                }
-                if(checkflag)
-                break;
+            if(stallTimeout.count() > 0 || watermarks.highDepth > 0 || watermarks.highAge.count() > 0){
+                watchdogTerminate = false;
+                stalledConsumers = 0;
+                watchdog = std::thread(&QuickLogger::WatchdogThread, this);
             }
         }
 
@@ -423,18 +3562,12 @@ class QuickLogger {
             Log *l = new Log();
             
             l->value = std::string(value);
-            int paramlength = 0;
-
-            ([&]
-            {
-
-                paramlength++;
-                while(parameters)break;
-
-            } (), ...);
+            int paramlength = sizeof...(P);
 
             l->logLevel = level;
             l->time = std::chrono::system_clock::now();
+            l->context = CurrentContext();
+            l->span = CurrentSpan();
 
 
             if(paramlength == 0){
@@ -442,24 +3575,137 @@ class QuickLogger {
             }
             else{
                 l->parameterFlag = true;               
-                l->saved_op = l->BuildOperation(std::move(l->value), std::move(parameters)...);
+                l->saved_op = l->BuildOperation(std::forward<P>(parameters)...);
             }
             
-            bool flag = true;
+            return Enqueue(l, threadID);
+        }
 
-            if(threadID < 0 || threadID >= processor_count){
-                return false;
+        /**
+         * @brief Logs a message with structured key/value fields.
+         * 
+         * The fields are created with kv() and are binary encoded into the Log with their
+         * types, so the consumer can render them as text or JSON keys without parsing and
+         * sinks can read them as they are from Log::fields.
+         * 
+         * @param level             Log Level
+         * @param threadID          Uniquely identifying thread ID
+         * @param message           The message of the Log, which is not formatted
+         * @param fields            The fields, created using kv()
+         * @return                  `true` if the operation was successful, otherwise `false`
+         */
+        template<typename ...F>
+        bool LogFields(int level, int threadID, std::string message, const KeyValue<F>&... fields){
+            Log *l = new Log();
+            l->value = std::move(message);
+            l->logLevel = level;
+            return PushFields(l, threadID, fields...);
+        }
+
+        /**
+         * @brief Logs structured fields for a registered call site, see QUICK_LOG_FIELDS.
+         * 
+         * The level and message are taken from the site, so only the site pointer and the
+         * encoded fields are stored in the Log.
+         * 
+         * @param site              The registered call site
+         * @param threadID          Uniquely identifying thread ID
+         * @param fields            The fields, created using kv()
+         * @return                  `true` if the operation was successful, otherwise `false`
+         */
+        template<typename ...F>
+        bool LogFields(const LogSite* site, int threadID, const KeyValue<F>&... fields){
+            Log *l = new Log();
+            l->site = site;
+            l->logLevel = site->level;
+            return PushFields(l, threadID, fields...);
+        }
+
+        /**
+         * @brief Logs a timer record, see ScopeTimer.
+         * 
+         * Only the site and the two raw timestamps are stored. The consumer converts them to
+         * the start time and the duration in nanoseconds, or records the duration in the
+         * histogram of the site if it is aggregated with AggregateSite.
+         * 
+         * @param site              The registered site naming the timer
+         * @param threadID          Uniquely identifying thread ID, negative for DefaultQueue()
+         * @param tscBegin          TscClock::now() at the start of the timed section
+         * @param tscEnd            TscClock::now() at the end of the timed section
+         * @return                  `true` if the operation was successful, otherwise `false`
+         */
+        bool LogTimer(const LogSite* site, int threadID, u_int64_t tscBegin, u_int64_t tscEnd){
+            if(threadID < 0){
+                threadID = DefaultQueue();
             }
-            else{
-                if(lockFreeQueues[threadID] != nullptr){
-                    lockFreeQueues[threadID]->push(l);
-                    flag = false;
-                }
-                
-                return !flag;
+            Log *l = new Log();
+            l->kind = TIMER_LOG;
+            l->site = site;
+            l->logLevel = site->level;
+            l->parameterFlag = false;
+            l->tscBegin = tscBegin;
+            l->tscEnd = tscEnd;
+            l->span = CurrentSpan();
+            return Enqueue(l, threadID);
+        }
+
+        /**
+         * @brief Returns the queue the calling thread uses when it doesn't name one.
+         * 
+         * Threads are assigned to the queues round robin in the order of their first call.
+         * 
+         * @return                  The thread ID, or -1 if the Logger is not started
+         */
+        int DefaultQueue(){
+            static std::atomic<unsigned int> nextProducer{0};
+            thread_local unsigned int producer = nextProducer.fetch_add(1, std::memory_order_relaxed);
+            if(processor_count <= 0){
+                return -1;
             }
+            return producer % processor_count;
+        }
+
+    private:
+
+        template<typename ...F>
+        bool PushFields(Log* l, int threadID, const KeyValue<F>&... fields){
+            l->time = std::chrono::system_clock::now();
+            l->context = CurrentContext();
+            l->span = CurrentSpan();
+            l->parameterFlag = false;
+            l->fields.reserve((size_t(0) + ... + EncodedFieldSize(fields)));
+            (EncodeField(l->fields, fields), ...);
+
+            return Enqueue(l, threadID);
+        }
+};
+
+
+/**
+ * @brief RAII timer logging the duration of a scope, see QUICK_SCOPE_TIMER.
+ *
+ * Reads the TscClock when constructed and destroyed and logs one timer record holding the
+ * site and both timestamps. Nothing is formatted on the producing thread.
+ */
+class ScopeTimer {
+    private:
+        QuickLogger     &logger;
+        const LogSite*  site;
+        int             threadID;
+        u_int64_t       begin;
 
+    public:
+        ScopeTimer(const LogSite* site) : ScopeTimer(QuickLogger::instance(), site, -1) {}
+
+        ScopeTimer(QuickLogger &logger, const LogSite* site, int threadID)
+            : logger(logger), site(site), threadID(threadID), begin(TscClock::now()) {}
+
+        ~ScopeTimer(){
+            logger.LogTimer(site, threadID, begin, TscClock::now());
         }
+
+        ScopeTimer(ScopeTimer const&) = delete;
+        void operator=(ScopeTimer const&) = delete;
 };
 
 /**
@@ -525,12 +3771,20 @@ QuickLogger &START_QUICK_LOGGER(int &num_of_threads){
  */
 void STOP_QUICK_LOGGER(QuickLogger& myLogger){
     printf("Stopping Logger\n");
+    if(myLogger.watchdog.joinable()){
+        myLogger.watchdogTerminate = true;
+        myLogger.watchdog.join();
+    }
     for(int i = 0 ; i < myLogger.processor_count ; i++){
         myLogger.threadTerminateFlags[i] = true;
         myLogger.threads[i].join();
     }
     myLogger.threads.clear();
 
+    for(auto &sink : myLogger.sinks){
+        sink->flush();
+    }
+
     for(int i = 0 ; i < LOG_TYPES ; i++){
         if(myLogger.outputFiles[i] != nullptr){
             fclose(myLogger.outputFiles[i]);
@@ -539,6 +3793,9 @@ void STOP_QUICK_LOGGER(QuickLogger& myLogger){
 
     myLogger.start_flag = true;
     myLogger.initInstanceFlag = true;
+    for(auto queue : myLogger.lockFreeQueues){
+        delete queue;
+    }
     myLogger.lockFreeQueues.clear();
     free(myLogger.threadTerminateFlags);
 
@@ -546,5 +3803,52 @@ void STOP_QUICK_LOGGER(QuickLogger& myLogger){
 }
 }
 
+/**
+ * @brief Logs structured fields from a call site which is registered once.
+ *
+ *      QUICK_LOG_FIELDS(myLogger, QuickLogger::INFO, threadID, "order filled", QuickLogger::kv("id", id), QuickLogger::kv("px", px));
+ *
+ * The message must be a string literal. Evaluates to `true` if the Log was queued.
+ */
+#define QUICK_LOG_FIELDS(logger, level, threadID, message, ...) \
+    ([&]() -> bool { \
+        static const ::QuickLogger::LogSite* quickLoggerSite = ::QuickLogger::RegisterSite(level, __FILE__, __LINE__, message); \
+        return (logger).LogFields(quickLoggerSite, threadID, ##__VA_ARGS__); \
+    }())
+
+#ifdef QUICK_LOGGER_FUNCTION_TRACE
+/**
+ * @brief Hooks called by code compiled with -finstrument-functions.
+ *
+ * Exclude the Logger itself from instrumentation, e.g. with
+ * -finstrument-functions-exclude-file-list=QuickLogger.hpp,xenium,fmt,/usr/include
+ */
+extern "C" {
+    QUICK_LOGGER_NO_INSTRUMENT void __cyg_profile_func_enter(void* function, void* callSite){
+        QuickLogger::RecordFunctionEvent(function, false);
+    }
+
+    QUICK_LOGGER_NO_INSTRUMENT void __cyg_profile_func_exit(void* function, void* callSite){
+        QuickLogger::RecordFunctionEvent(function, true);
+    }
+}
+#endif
+
+#define QUICK_LOGGER_CONCAT_(a, b) a##b
+#define QUICK_LOGGER_CONCAT(a, b) QUICK_LOGGER_CONCAT_(a, b)
+
+/**
+ * @brief Times the rest of the enclosing scope.
+ *
+ *      QUICK_SCOPE_TIMER("match orders");
+ *
+ * Logs to the TRACE level of the running Logger, on the queue returned by DefaultQueue().
+ * The line reads "<name> duration_ns=<duration>", unless the name is aggregated with
+ * AggregateSite, in which case the durations feed the histogram of the site instead.
+ */
+#define QUICK_SCOPE_TIMER(name) \
+    static const ::QuickLogger::LogSite* QUICK_LOGGER_CONCAT(quickLoggerTimerSite, __LINE__) = ::QuickLogger::RegisterSite(::QuickLogger::TRACE, __FILE__, __LINE__, name); \
+    ::QuickLogger::ScopeTimer QUICK_LOGGER_CONCAT(quickLoggerTimer, __LINE__)(QUICK_LOGGER_CONCAT(quickLoggerTimerSite, __LINE__))
+
 
 #endif
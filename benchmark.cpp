@@ -1,6 +1,12 @@
 #include <bits/stdc++.h>
 #include "QuickLogger.hpp"
+#include "benchmarks/baseline_loggers.hpp"
+#include "benchmarks/allocation_counter.hpp"
+#include "benchmarks/perf_counters.hpp"
+#include <fcntl.h>
 #include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
 
 inline void SetCpuAffinity(int cpu)
 {
@@ -14,52 +20,974 @@ inline void SetCpuAffinity(int cpu)
     }
 }
 
-void benchmark(QuickLogger::QuickLogger &myLogger, int threadID, int cpu, int threads){
+/**
+ * @brief Per call latency and counts of one producer thread.
+ *
+ * latency holds raw TscClock ticks per LogItem call, converted to nanoseconds when printed.
+ * counters are the thread's perf counters over its Logs, if the config asked for them.
+ * Aligned to a cache line, the producers update neighbouring results in the timed loop.
+ */
+struct alignas(64) ProducerResult {
+    QuickLogger::Histogram latency;
+    uint64_t               logs = 0;
+    uint64_t               failed = 0;
+    uint64_t               nanoseconds = 0;
+    PerfCounts             counters;
+};
+
+void PrintLatency(const char* name, const QuickLogger::Histogram &h){
+    auto ns = [](uint64_t ticks){ return (unsigned long long)QuickLogger::TscClock::ToNanoseconds(ticks); };
+    printf("\t%-10s p50=%llu p90=%llu p99=%llu p99.9=%llu p99.99=%llu max=%llu\n", name, ns(h.percentile(0.5)), ns(h.percentile(0.9)),
+           ns(h.percentile(0.99)), ns(h.percentile(0.999)), ns(h.percentile(0.9999)), ns(h.max()));
+}
+
+/**
+ * @brief Arrival process of the fixed rate producers.
+ */
+enum ARRIVALS { UNIFORM_ARRIVALS, POISSON_ARRIVALS };
+
+/**
+ * @brief One point of the benchmark matrix.
+ *
+ * Attributes:
+ *  * producers, consumers
+ *    Number of producer threads and of consumer threads (queues). Producer i logs to queue
+ *    i % consumers.
+ *  * mix
+ *    The arguments every Log is made of, see BenchmarkMessage and LogMix.
+ *  * size
+ *    Length of the message text before formatting.
+ *  * level
+ *    The level of every Log, -1 to cycle through all levels.
+ *  * logger
+ *    "quick" for QuickLogger, otherwise the name of a baseline, see baseline_loggers.hpp.
+ *  * sink
+ *    Where the lines go: "file" for the log files, "null" and "memory" for a NullSink and a
+ *    MemorySink without file output, "stdout" for the coloured STDOUT output alone, with
+ *    STDOUT sent to /dev/null during the run. Only QuickLogger supports other sinks than "file".
+ *  * mode
+ *    "tight" logs iterations Logs back to back, "rate" logs at rate per producer for duration,
+ *    "burst" logs like "tight" and after the backlog drained stays idle for duration,
+ *    "consume" queues iterations Logs with the consumers paused and then times the consumers
+ *    alone draining them, QuickLogger only.
+ *  * allocations
+ *    Count the heap allocations of the run, see allocation_counter.hpp.
+ *  * counters
+ *    Collect perf counters of the producer and consumer threads, see perf_counters.hpp.
+ */
+struct BenchmarkConfig {
+    int                       producers = 2;
+    int                       consumers = 2;
+    std::string               mix = "static";
+    int                       size = 7;
+    int                       level = -1;
+    std::string               logger = "quick";
+    std::string               sink = "file";
+    std::string               mode = "tight";
+    long long                 iterations = 8e7;
+    double                    rate = 1e6;
+    ARRIVALS                  arrivals = POISSON_ARRIVALS;
+    std::chrono::milliseconds duration{1000};
+    bool                      allocations = false;
+    bool                      counters = false;
+};
+
+/**
+ * @brief Logs one consumer wrote while the backlog drained and its busy nanoseconds doing so.
+ */
+struct ConsumerDrain {
+    uint64_t logs = 0;
+    uint64_t busyNanoseconds = 0;
+};
+
+/**
+ * @brief Results of one run of the Logger, see run_benchmark.
+ *
+ * cpuSeconds is the user and system time of the whole process during the run, peakRssKB its
+ * peak resident set size, since the start of the run where the kernel allows resetting it.
+ * meanRssKB is the mean of the resident set size sampled every 10 milliseconds while the
+ * Logger runs, the steady state footprint, and endRssKB the size after the Logger stopped.
+ * backlog is the number of Logs not yet written when the last producer finished and
+ * drainNanoseconds the time from then until all of them were written, measured before the
+ * Logger is stopped. drainConsumers holds per consumer the Logs it wrote during the drain and
+ * the busy time it spent on them. startRssKB, producerEndRssKB and idleRssKB are the resident set size
+ * before the Logger started, when the producers finished and, in burst mode, after the idle
+ * time, which shows whether the memory of the backlog is given back.
+ * allocations and producerAllocations count the heap allocations of all threads and of the
+ * producer threads during the run, if the config asked for them. producerCounters sums the perf
+ * counters of the producers, consumerCounters holds those of all other threads the run started,
+ * i.e. the consumers, and of the main thread waiting for them. In rate mode producerCounters
+ * is left unavailable, the producers spend most of the run waiting for their send times.
+ */
+struct RunResult {
+    std::vector<ProducerResult> producers;
+    QuickLogger::Histogram      latency;
+    QuickLogger::LoggerMetrics  metrics;
+    long long                   nanoseconds = 0;
+    double                      cpuSeconds = 0;
+    long                        peakRssKB = 0;
+    long                        meanRssKB = 0;
+    long                        endRssKB = 0;
+    long                        startRssKB = 0;
+    long                        producerEndRssKB = 0;
+    long                        idleRssKB = 0;
+    uint64_t                    backlog = 0;
+    long long                   drainNanoseconds = 0;
+    std::vector<ConsumerDrain>  drainConsumers;
+    AllocationCounter::Totals   allocations;
+    AllocationCounter::Totals   producerAllocations;
+    PerfCounts                  producerCounters;
+    PerfCounts                  consumerCounters;
+};
+
+/**
+ * @brief A user defined type logged by the "user" mix, formatted through its fmt::formatter.
+ */
+struct Order {
+    uint64_t id;
+    double   price;
+    int      quantity;
+};
+
+template<>
+struct fmt::formatter<Order> : fmt::formatter<std::string_view> {
+    template<typename FormatContext>
+    auto format(const Order &order, FormatContext &ctx) const -> decltype(ctx.out()) {
+        return fmt::format_to(ctx.out(), "Order#{} {}@{}", order.id, order.quantity, order.price);
+    }
+};
+
+/**
+ * @brief The argument mixes, in the order of MIXES.
+ *
+ *  static       the message only
+ *  int          one integer
+ *  float        one double
+ *  mixed        an integer, a double and a string literal
+ *  string       a string literal
+ *  long_string  a std::string of 256 characters which changes with every Log
+ *  many         eight integers and doubles
+ *  user         an Order
+ */
+enum ARG_MIX { STATIC_MIX, INT_MIX, FLOAT_MIX, MIXED_MIX, STRING_MIX, LONG_STRING_MIX, MANY_MIX, USER_MIX };
+
+static const char* MIXES[] = {"static", "int", "float", "mixed", "string", "long_string", "many", "user"};
+static const char* MIX_PLACEHOLDERS[] = {"", " {}", " {}", " {} {} {}", " {}", " {}", " {} {} {} {} {} {} {} {}", " {}"};
+
+int MixIndex(const std::string &mix){
+    return std::find(std::begin(MIXES), std::end(MIXES), mix) - std::begin(MIXES);
+}
+
+/**
+ * @brief Returns the message of a mix, padded to size characters before the placeholders.
+ */
+std::string BenchmarkMessage(const BenchmarkConfig &config){
+    std::string message = "LOGGING";
+    if((int)message.size() < config.size){
+        message.append(config.size - message.size(), 'x');
+    }
+    return message + MIX_PLACEHOLDERS[MixIndex(config.mix)];
+}
+
+/**
+ * @brief Logs one Log of the given mix.
+ *
+ * dynamic is the producer's string for the long_string mix, one character of it changes per Log.
+ */
+template<typename Logger>
+inline bool LogMix(Logger &myLogger, int mix, int level, int queue, uint64_t i,
+                   const std::string &message, std::string &dynamic){
+    switch(mix){
+        case INT_MIX:
+            return myLogger.LogItem(level, queue, message, i);
+        case FLOAT_MIX:
+            return myLogger.LogItem(level, queue, message, i * 0.25);
+        case MIXED_MIX:
+            return myLogger.LogItem(level, queue, message, i, i * 0.25, "filled");
+        case STRING_MIX:
+            return myLogger.LogItem(level, queue, message, "a short string argument");
+        case LONG_STRING_MIX:
+            dynamic[i % dynamic.size()] = 'a' + i % 26;
+            return myLogger.LogItem(level, queue, message, dynamic);
+        case MANY_MIX:
+            return myLogger.LogItem(level, queue, message, i, i + 1, i + 2, i + 3, i * 0.5, i * 1.5, i * 2.5, i * 3.5);
+        case USER_MIX:
+            return myLogger.LogItem(level, queue, message, Order{i, 100.25 + i % 100, (int)(i % 1000)});
+        default:
+            return myLogger.LogItem(level, queue, message);
+    }
+}
+
+template<typename Logger>
+void benchmark(Logger &myLogger, int threadID, int cpu, const BenchmarkConfig &config, ProducerResult &result){
     SetCpuAffinity(cpu);
-    int const iters =  8e7/threads;
-    const char* text = "BENCHMARK";
+    AllocationCounter::MarkProducer();
+    PerfCounters counters;
+    if(config.counters){
+        counters.Open();
+    }
+    long long const iters = config.iterations/config.producers;
+    int queue = threadID % config.consumers;
+    int mix = MixIndex(config.mix);
+    std::string message = BenchmarkMessage(config);
+    std::string dynamic(256, 'x');
     uint64_t begin = std::chrono::high_resolution_clock::now().time_since_epoch() / std::chrono::nanoseconds(1);
-    for(int i = 0 ; i < iters ; i++){
-        if(!myLogger.LogItem(i%QuickLogger::LOG_TYPES, threadID,  "LOGGING")){
-            printf("Unable to log %d!\n", i);
+    for(long long i = 0 ; i < iters ; i++){
+        int level = config.level < 0 ? i%QuickLogger::LOG_TYPES : config.level;
+        uint64_t start = QuickLogger::TscClock::now();
+        bool logged = LogMix(myLogger, mix, level, queue, i, message, dynamic);
+        result.latency.record(QuickLogger::TscClock::now() - start);
+        if(!logged){
+            result.failed++;
         }
     }
     uint64_t end = std::chrono::high_resolution_clock::now().time_since_epoch() / std::chrono::nanoseconds(1);
-    long int avg_latency = (end-begin)/iters;
-    long long int tot_time = end-begin;
-    printf("\tAverage Latency = %ld nanoseconds\n", avg_latency);
-    printf("\tTotal Time Taken for Logging was %lld nanoseconds\n", tot_time);
+    result.counters = counters.Read();
+    result.logs = iters;
+    result.nanoseconds = end-begin;
+}
+
+/**
+ * @brief Logs at a fixed rate for a fixed time, measuring each call from its intended send time.
+ *
+ * Sends are scheduled in advance, uniformly or as a Poisson process, and a producer which falls
+ * behind sends the late Logs back to back. Their latency includes the time they were late, so a
+ * stall of the Logger shows up in every Log it delayed, not only in the one call that stalled
+ * (no coordinated omission).
+ */
+template<typename Logger>
+void fixed_rate_benchmark(Logger &myLogger, int threadID, int cpu, const BenchmarkConfig &config, ProducerResult &result){
+    SetCpuAffinity(cpu);
+    AllocationCounter::MarkProducer();
+    PerfCounters counters;
+    if(config.counters){
+        counters.Open();
+    }
+    int queue = threadID % config.consumers;
+    int mix = MixIndex(config.mix);
+    std::string message = BenchmarkMessage(config);
+    std::string dynamic(256, 'x');
+    double ticksPerLog = 1e9 / config.rate / QuickLogger::TscClock::NanosecondsPerTick();
+    std::mt19937_64 random(threadID + 1);
+    std::exponential_distribution<double> exponential(1.0);
+
+    uint64_t begin = QuickLogger::TscClock::now();
+    uint64_t stop = begin + (uint64_t)(std::chrono::nanoseconds(config.duration).count() / QuickLogger::TscClock::NanosecondsPerTick());
+    double intended = begin;
+    uint64_t i = 0;
+    while(intended < stop){
+        uint64_t send = (uint64_t)intended;
+        while(QuickLogger::TscClock::now() < send){
+        }
+        int level = config.level < 0 ? i%QuickLogger::LOG_TYPES : config.level;
+        bool logged = LogMix(myLogger, mix, level, queue, i, message, dynamic);
+        result.latency.record(QuickLogger::TscClock::now() - send);
+        if(!logged){
+            result.failed++;
+        }
+        intended += config.arrivals == POISSON_ARRIVALS ? exponential(random) * ticksPerLog : ticksPerLog;
+        i++;
+    }
+    result.counters = counters.Read();
+    result.logs = i;
+    result.nanoseconds = QuickLogger::TscClock::ToNanoseconds(QuickLogger::TscClock::now() - begin);
 }
 
-template<typename Function>
-void run_benchmark(Function && f, int thread_count, int total_cores){
-    printf("\nThread Count : %d\n", thread_count);
+double CpuSeconds(){
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/**
+ * @brief Resets the peak RSS of the process, where the kernel supports it.
+ */
+void ResetPeakRss(){
+    std::ofstream clear("/proc/self/clear_refs");
+    clear << "5";
+}
+
+long PeakRssKB(){
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while(std::getline(status, line)){
+        if(line.compare(0, 6, "VmHWM:") == 0){
+            return std::atol(line.c_str() + 6);
+        }
+    }
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+ * @brief Returns the current resident set size without allocating, 0 if it cannot be read.
+ */
+long CurrentRssKB(){
+    char buffer[64] = {};
+    int fd = open("/proc/self/statm", O_RDONLY);
+    if(fd < 0){
+        return 0;
+    }
+    ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if(length <= 0){
+        return 0;
+    }
+    long pages = 0, resident = 0;
+    if(sscanf(buffer, "%ld %ld", &pages, &resident) != 2){
+        return 0;
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+AllocationCounter::Totals operator-(const AllocationCounter::Totals &a, const AllocationCounter::Totals &b){
+    AllocationCounter::Totals difference;
+    difference.allocations = a.allocations - b.allocations;
+    difference.bytes = a.bytes - b.bytes;
+    difference.frees = a.frees - b.frees;
+    return difference;
+}
+
+/**
+ * @brief Returns the Logs written plus those the consumers found lost.
+ */
+uint64_t Finished(const QuickLogger::LoggerMetrics &metrics){
+    return std::accumulate(std::begin(metrics.written), std::end(metrics.written), metrics.lost);
+}
+
+/**
+ * @brief Starts a logger, runs the producer threads of the config and stops the logger.
+ *
+ * start() returns the started logger, stop(logger) stops it and returns its metrics. Between
+ * the end of the producers and the stop the consumers drain the backlog and the drain is timed
+ * on its own, so STOP only finds empty queues.
+ */
+template<typename Logger, typename Start, typename Stop>
+RunResult run_benchmark(const BenchmarkConfig &config, int total_cores, Start start, Stop stop){
     std::vector<std::thread> threads;
+    RunResult run;
+    run.producers.resize(config.producers);
+    ResetPeakRss();
+    double cpu = CpuSeconds();
+    AllocationCounter::enabled.store(config.allocations);
+    AllocationCounter::Totals allocations = AllocationCounter::Sum(), producerAllocations = AllocationCounter::Sum(true);
+
+    // The sampler neither allocates nor marks itself a producer, so it does not show in the counts.
+    std::atomic<bool> sampling{true};
+    long long rssSum = 0, rssSamples = 0;
+    std::thread sampler([&]{
+        while(sampling.load()){
+            rssSum += CurrentRssKB();
+            rssSamples++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    });
 
+    // Inherited by every thread started from here on, their counts are added as they exit.
+    PerfCounters process;
+    if(config.counters){
+        process.Open(true);
+        for(int i = 0 ; i < PerfCounts::EVENTS ; i++){
+            if(!process.isOpen(i)){
+                fprintf(stderr, "perf_event_open failed for %s (%s), reported empty\n", PerfCounters::NAMES[i], std::strerror(process.error));
+            }
+        }
+    }
+
+    run.startRssKB = CurrentRssKB();
     uint64_t begin = std::chrono::high_resolution_clock::now().time_since_epoch() / std::chrono::nanoseconds(1);
 
-    QuickLogger::QuickLogger &myLogger = QuickLogger::START_QUICK_LOGGER("", thread_count, false);
+    Logger &myLogger = start();
 
-    for(int i = 0 ; i < thread_count ; i++){
-        threads.push_back(std::thread(f, std::ref(myLogger), i, total_cores -(i%total_cores), thread_count ) );
+    auto f = config.mode == "rate" ? fixed_rate_benchmark<Logger> : benchmark<Logger>;
+    for(int i = 0 ; i < config.producers ; i++){
+        threads.push_back(std::thread(f, std::ref(myLogger), i, total_cores -(i%total_cores), std::cref(config), std::ref(run.producers[i]) ) );
     }
-    for(int i = 0 ; i < thread_count ; i++){
+    for(int i = 0 ; i < config.producers ; i++){
         threads[i].join();
     }
-    // std::this_thread::sleep_for(std::chrono::seconds(10));
-    QuickLogger::STOP_QUICK_LOGGER(myLogger);
+
+    if constexpr(std::is_same_v<Logger, QuickLogger::QuickLogger>){
+        if(config.mode == "consume"){
+            myLogger.resumeConsumers();
+        }
+    }
+    auto producersEnd = std::chrono::steady_clock::now();
+    run.producerEndRssKB = CurrentRssKB();
+    uint64_t sent = 0;
+    for(auto &result : run.producers){
+        sent += result.logs - result.failed;
+    }
+    QuickLogger::LoggerMetrics drainStart = myLogger.metrics(), drainEnd = drainStart;
+    uint64_t finished = Finished(drainStart);
+    run.backlog = sent > finished ? sent - finished : 0;
+    // Gives up after a minute, a Logger which loses Logs without noticing would never drain.
+    while(finished < sent && std::chrono::steady_clock::now() - producersEnd < std::chrono::minutes(1)){
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        drainEnd = myLogger.metrics();
+        finished = Finished(drainEnd);
+    }
+    run.drainNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - producersEnd).count();
+    for(size_t i = 0 ; i < drainEnd.consumers.size() && i < drainStart.consumers.size() ; i++){
+        const QuickLogger::ConsumerMetrics &before = drainStart.consumers[i], &after = drainEnd.consumers[i];
+        ConsumerDrain drain;
+        drain.logs = std::accumulate(std::begin(after.written), std::end(after.written), after.aggregated) -
+                     std::accumulate(std::begin(before.written), std::end(before.written), before.aggregated);
+        drain.busyNanoseconds = after.busyNanoseconds - before.busyNanoseconds;
+        run.drainConsumers.push_back(drain);
+    }
+    if(config.mode == "burst"){
+        std::this_thread::sleep_for(config.duration);
+        run.idleRssKB = CurrentRssKB();
+    }
+
+    run.metrics = stop(myLogger);
     uint64_t end = std::chrono::high_resolution_clock::now().time_since_epoch() / std::chrono::nanoseconds(1);
-    long long int time_taken = end-begin;
-    printf("\nTotal Time Taken from start to end is %lld nanoseconds.\n", time_taken);
-    return;
+    PerfCounts processCounters = process.Read();
+    sampling.store(false);
+    sampler.join();
+    run.nanoseconds = end-begin;
+    run.cpuSeconds = CpuSeconds() - cpu;
+    run.peakRssKB = PeakRssKB();
+    run.meanRssKB = rssSamples > 0 ? rssSum / rssSamples : 0;
+    run.endRssKB = CurrentRssKB();
+    run.allocations = AllocationCounter::Sum() - allocations;
+    run.producerAllocations = AllocationCounter::Sum(true) - producerAllocations;
+    AllocationCounter::enabled.store(false);
+    if(config.allocations && AllocationCounter::overflowed.exchange(false)){
+        fprintf(stderr, "More than %d threads counted allocations at once, the extra ones were not told apart as producers\n",
+                AllocationCounter::MAX_THREADS - 1);
+    }
+
+    run.producerCounters.value[0] = config.counters ? 0 : -1;
+    std::fill(std::begin(run.producerCounters.value), std::end(run.producerCounters.value), run.producerCounters.value[0]);
+    for(auto &result : run.producers){
+        run.latency.merge(result.latency);
+        run.producerCounters += result.counters;
+    }
+    run.consumerCounters = processCounters - run.producerCounters;
+    if(config.mode == "rate"){
+        // Counted only to be taken out of the consumers, a rate producer mostly spins until its next send.
+        run.producerCounters = PerfCounts();
+    }
+    return run;
 }
 
-int main(){
+RunResult run_config(const BenchmarkConfig &config, int total_cores){
+    if(config.logger == "quick"){
+        int savedStdout = -1;
+        return run_benchmark<QuickLogger::QuickLogger>(config, total_cores, [&]() -> QuickLogger::QuickLogger& {
+            QuickLogger::QuickLogger &myLogger = QuickLogger::QuickLogger::instance();
+            myLogger.sinks.clear();
+            myLogger.setFileOutput(config.sink == "file");
+            if(config.sink == "null"){
+                myLogger.addSink(std::make_shared<QuickLogger::NullSink>());
+            }
+            else if(config.sink == "memory"){
+                myLogger.addSink(std::make_shared<QuickLogger::MemorySink>(config.consumers));
+            }
+            else if(config.sink == "stdout"){
+                std::fflush(stdout);
+                savedStdout = dup(STDOUT_FILENO);
+                int devNull = open("/dev/null", O_WRONLY);
+                dup2(devNull, STDOUT_FILENO);
+                close(devNull);
+            }
+            if(config.mode == "consume"){
+                myLogger.pauseConsumers();
+            }
+            int consumers = config.consumers;
+            return QuickLogger::START_QUICK_LOGGER("", consumers, config.sink == "stdout");
+        }, [&](QuickLogger::QuickLogger &myLogger){
+            QuickLogger::STOP_QUICK_LOGGER(myLogger);
+            myLogger.resumeConsumers();
+            myLogger.sinks.clear();
+            myLogger.setFileOutput(true);
+            if(savedStdout >= 0){
+                std::fflush(stdout);
+                dup2(savedStdout, STDOUT_FILENO);
+                close(savedStdout);
+            }
+            return myLogger.metrics();
+        });
+    }
+
+    std::unique_ptr<BaselineLogger> baseline = MakeBaselineLogger(config.logger);
+    return run_benchmark<BaselineLogger>(config, total_cores, [&]() -> BaselineLogger& {
+        baseline->Start(std::filesystem::current_path() / "logs" / config.logger, config.consumers);
+        return *baseline;
+    }, [](BaselineLogger &myLogger){
+        myLogger.Stop();
+        return myLogger.metrics();
+    });
+}
+
+void PrintRun(const RunResult &run){
+    printf("\nThread Count : %zu\n", run.producers.size());
+    printf("\nTotal Time Taken from start to end is %lld nanoseconds.\n", run.nanoseconds);
 
-    for(auto threads : {2}){
-        run_benchmark(benchmark, threads, 8);
+    printf("\nLogItem latency (nanoseconds):\n");
+    for(size_t i = 0 ; i < run.producers.size() ; i++){
+        const ProducerResult &result = run.producers[i];
+        char name[32];
+        snprintf(name, sizeof(name), "thread %zu", i);
+        PrintLatency(name, result.latency);
+        printf("\t%10s %llu logs in %llu nanoseconds, %llu failed\n", "", (unsigned long long)result.logs,
+               (unsigned long long)result.nanoseconds, (unsigned long long)result.failed);
     }
+    PrintLatency("combined", run.latency);
 
+    const QuickLogger::LoggerMetrics &metrics = run.metrics;
+    unsigned long long enqueued = 0, written = 0;
+    for(int level = 0 ; level < QuickLogger::LOG_TYPES ; level++){
+        enqueued += metrics.enqueued[level];
+        written += metrics.written[level];
+    }
+    printf("\nLogs enqueued=%llu written=%llu dropped=%llu lost=%llu\n", enqueued, written,
+           (unsigned long long)metrics.dropped, (unsigned long long)metrics.lost);
+    printf("CPU time %.3f seconds, RSS mean %ld kB peak %ld kB after stop %ld kB\n", run.cpuSeconds, run.meanRssKB,
+           run.peakRssKB, run.endRssKB);
+    printf("Backlog of %llu Logs when the producers finished drained in %.3f ms, RSS %ld kB before start, %ld kB at the end of the producers",
+           (unsigned long long)run.backlog, run.drainNanoseconds / 1e6, run.startRssKB, run.producerEndRssKB);
+    if(run.idleRssKB > 0){
+        printf(", %ld kB after idling", run.idleRssKB);
+    }
+    printf("\n");
+    for(size_t i = 0 ; i < run.drainConsumers.size() ; i++){
+        const ConsumerDrain &drain = run.drainConsumers[i];
+        printf("\tconsumer %zu drained %llu Logs, %.0f logs per busy second\n", i, (unsigned long long)drain.logs,
+               drain.busyNanoseconds > 0 ? drain.logs * 1e9 / drain.busyNanoseconds : 0.0);
+    }
+    uint64_t logs = 0;
+    for(auto &result : run.producers){
+        logs += result.logs;
+    }
+    if(run.producerCounters.available() || run.consumerCounters.available()){
+        uint64_t written = 0;
+        for(int level = 0 ; level < QuickLogger::LOG_TYPES ; level++){
+            written += run.metrics.written[level];
+        }
+        for(auto side : {std::make_pair("Producers", logs), std::make_pair("Consumers", written)}){
+            const PerfCounts &counts = side.first[0] == 'P' ? run.producerCounters : run.consumerCounters;
+            printf("%s per Log:", side.first);
+            for(int i = 0 ; i < PerfCounts::EVENTS ; i++){
+                if(counts.value[i] >= 0 && side.second > 0){
+                    printf(" %s=%.2f", PerfCounters::NAMES[i], (double)counts.value[i] / side.second);
+                }
+            }
+            printf("\n");
+        }
+    }
+    if(run.allocations.allocations > 0 && logs > 0){
+        printf("Allocations per Log %.2f (%.1f bytes), in the producers %.2f (%.1f bytes), %lld not freed\n",
+               (double)run.allocations.allocations / logs, (double)run.allocations.bytes / logs,
+               (double)run.producerAllocations.allocations / logs, (double)run.producerAllocations.bytes / logs,
+               (long long)(run.allocations.allocations - run.allocations.frees));
+    }
+    printf("\nEnqueue to write latency (nanoseconds):\n");
+    for(int level = 0 ; level < QuickLogger::LOG_TYPES ; level++){
+        const QuickLogger::Histogram &h = metrics.endToEnd[level];
+        if(h.count() == 0){
+            continue;
+        }
+        printf("\t%-5s count=%llu p50=%llu p90=%llu p99=%llu p99.9=%llu max=%llu\n", QuickLogger::logLevelMessages[level].c_str(),
+               (unsigned long long)h.count(), (unsigned long long)h.percentile(0.5), (unsigned long long)h.percentile(0.9),
+               (unsigned long long)h.percentile(0.99), (unsigned long long)h.percentile(0.999), (unsigned long long)h.max());
+    }
+    for(auto &consumer : metrics.consumers){
+        uint64_t consumerWritten = std::accumulate(std::begin(consumer.written), std::end(consumer.written), (uint64_t)0);
+        printf("\tconsumer %d: queue wait p99=%llu format p99=%llu write p99=%llu, %.0f logs per busy second\n", consumer.consumerID,
+               (unsigned long long)consumer.queueWait.percentile(0.99), (unsigned long long)consumer.formatLatency.percentile(0.99),
+               (unsigned long long)consumer.writeLatency.percentile(0.99),
+               consumer.busyNanoseconds > 0 ? consumerWritten * 1e9 / consumer.busyNanoseconds : 0.0);
+    }
+}
+
+/**
+ * @brief Runs the fixed rate benchmark at increasing offered loads.
+ *
+ * Prints one row per rate, the knee is where the achieved rate falls behind the offered one
+ * or the tail latency takes off.
+ */
+void sweep_offered_load(BenchmarkConfig config, int total_cores, std::initializer_list<double> rates){
+    printf("\nFixed rate sweep, %d threads, %s arrivals, latency from the intended send time (nanoseconds):\n", config.producers,
+           config.arrivals == POISSON_ARRIVALS ? "Poisson" : "uniform");
+    printf("\t%12s %12s %10s %10s %10s %10s %12s %14s\n", "offered/s", "achieved/s", "p50", "p99", "p99.9", "p99.99", "max", "e2e p99");
+    config.mode = "rate";
+    for(double rate : rates){
+        config.rate = rate;
+        RunResult run = run_config(config, total_cores);
+
+        double achieved = 0;
+        for(auto &result : run.producers){
+            achieved += result.nanoseconds > 0 ? result.logs * 1e9 / result.nanoseconds : 0;
+        }
+        QuickLogger::Histogram endToEnd;
+        for(int level = 0 ; level < QuickLogger::LOG_TYPES ; level++){
+            endToEnd.merge(run.metrics.endToEnd[level]);
+        }
+        auto ns = [](uint64_t ticks){ return (unsigned long long)QuickLogger::TscClock::ToNanoseconds(ticks); };
+        const QuickLogger::Histogram &h = run.latency;
+        printf("\t%12.0f %12.0f %10llu %10llu %10llu %10llu %12llu %14llu\n", rate * config.producers, achieved, ns(h.percentile(0.5)),
+               ns(h.percentile(0.99)), ns(h.percentile(0.999)), ns(h.percentile(0.9999)), ns(h.max()),
+               (unsigned long long)endToEnd.percentile(0.99));
+    }
+}
+
+/**
+ * @brief The numbers reported for one run, in output order.
+ */
+std::vector<std::pair<std::string, std::string>> ResultColumns(const BenchmarkConfig &config, const RunResult &run){
+    auto ns = [](uint64_t ticks){ return fmt::to_string(QuickLogger::TscClock::ToNanoseconds(ticks)); };
+    uint64_t logs = 0, failed = 0, producerNanoseconds = 0, written = 0;
+    for(auto &result : run.producers){
+        logs += result.logs;
+        failed += result.failed;
+        producerNanoseconds = std::max(producerNanoseconds, result.nanoseconds);
+    }
+    QuickLogger::Histogram endToEnd, format;
+    for(int level = 0 ; level < QuickLogger::LOG_TYPES ; level++){
+        written += run.metrics.written[level];
+        endToEnd.merge(run.metrics.endToEnd[level]);
+    }
+    uint64_t busyNanoseconds = 0;
+    for(auto &consumer : run.metrics.consumers){
+        busyNanoseconds += consumer.busyNanoseconds;
+        format.merge(consumer.formatLatency);
+    }
+    // Per consumer, so an imbalance between the queues shows as a spread between min and max.
+    // Consumers which wrote nothing during the drain have no rate.
+    std::vector<uint64_t> drainLogs;
+    std::vector<double> drainRates;
+    for(auto &drain : run.drainConsumers){
+        drainLogs.push_back(drain.logs);
+        if(drain.logs > 0 && drain.busyNanoseconds > 0){
+            drainRates.push_back(drain.logs * 1e9 / drain.busyNanoseconds);
+        }
+    }
+    std::sort(drainLogs.begin(), drainLogs.end());
+    std::sort(drainRates.begin(), drainRates.end());
+    auto perLog = [&](uint64_t count){ return config.allocations && logs > 0 ? fmt::format("{:.2f}", (double)count / logs) : std::string(); };
+    const QuickLogger::Histogram &h = run.latency;
+    std::vector<std::pair<std::string, std::string>> counters;
+    for(auto side : {std::make_pair("producer", logs), std::make_pair("consumer", written)}){
+        const PerfCounts &counts = side.first[0] == 'p' ? run.producerCounters : run.consumerCounters;
+        for(int i = 0 ; i < PerfCounts::EVENTS ; i++){
+            counters.emplace_back(fmt::format("{}_{}_per_log", side.first, PerfCounters::NAMES[i]),
+                                  counts.value[i] >= 0 && side.second > 0 ? fmt::format("{:.4f}", (double)counts.value[i] / side.second) : "");
+        }
+    }
+    std::vector<std::pair<std::string, std::string>> columns = {
+        {"producers", fmt::to_string(config.producers)},
+        {"consumers", fmt::to_string(config.consumers)},
+        {"mix", config.mix},
+        {"size", fmt::to_string(config.size)},
+        {"level", config.level < 0 ? "all" : QuickLogger::logLevelMessages[config.level]},
+        {"logger", config.logger},
+        {"sink", config.sink},
+        {"mode", config.mode},
+        {"rate", config.mode == "rate" ? fmt::format("{:.0f}", config.rate) : ""},
+        {"arrivals", config.mode == "rate" ? (config.arrivals == POISSON_ARRIVALS ? "poisson" : "uniform") : ""},
+        {"queue", config.logger == "quick" ? fmt::format("ramalhete/{}", QUICK_LOGGER_ENTRIES_PER_NODE) : config.logger},
+        {"logs", fmt::to_string(logs)},
+        {"failed", fmt::to_string(failed)},
+        {"written", fmt::to_string(written)},
+        {"dropped", fmt::to_string(run.metrics.dropped)},
+        {"lost", fmt::to_string(run.metrics.lost)},
+        {"producer_seconds", fmt::format("{:.6f}", producerNanoseconds / 1e9)},
+        {"total_seconds", fmt::format("{:.6f}", run.nanoseconds / 1e9)},
+        {"producer_logs_per_second", fmt::format("{:.0f}", producerNanoseconds > 0 ? logs * 1e9 / producerNanoseconds : 0)},
+        {"written_logs_per_second", fmt::format("{:.0f}", run.nanoseconds > 0 ? written * 1e9 / run.nanoseconds : 0)},
+        {"consumer_logs_per_busy_second", fmt::format("{:.0f}", busyNanoseconds > 0 ? written * 1e9 / busyNanoseconds : 0)},
+        {"p50_ns", ns(h.percentile(0.5))},
+        {"p90_ns", ns(h.percentile(0.9))},
+        {"p99_ns", ns(h.percentile(0.99))},
+        {"p999_ns", ns(h.percentile(0.999))},
+        {"p9999_ns", ns(h.percentile(0.9999))},
+        {"max_ns", ns(h.max())},
+        {"e2e_p50_ns", fmt::to_string(endToEnd.percentile(0.5))},
+        {"e2e_p99_ns", fmt::to_string(endToEnd.percentile(0.99))},
+        {"e2e_max_ns", fmt::to_string(endToEnd.max())},
+        {"format_p50_ns", fmt::to_string(format.percentile(0.5))},
+        {"format_p99_ns", fmt::to_string(format.percentile(0.99))},
+        {"cpu_seconds", fmt::format("{:.3f}", run.cpuSeconds)},
+        {"peak_rss_kb", fmt::to_string(run.peakRssKB)},
+        {"mean_rss_kb", fmt::to_string(run.meanRssKB)},
+        {"end_rss_kb", fmt::to_string(run.endRssKB)},
+        {"start_rss_kb", fmt::to_string(run.startRssKB)},
+        {"producer_end_rss_kb", fmt::to_string(run.producerEndRssKB)},
+        {"idle_rss_kb", config.mode == "burst" ? fmt::to_string(run.idleRssKB) : ""},
+        {"backlog", fmt::to_string(run.backlog)},
+        {"drain_seconds", fmt::format("{:.6f}", run.drainNanoseconds / 1e9)},
+        {"drain_logs_per_second", fmt::format("{:.0f}", run.drainNanoseconds > 0 ? run.backlog * 1e9 / run.drainNanoseconds : 0)},
+        {"drain_consumer_logs_min", drainLogs.empty() ? "" : fmt::to_string(drainLogs.front())},
+        {"drain_consumer_logs_max", drainLogs.empty() ? "" : fmt::to_string(drainLogs.back())},
+        {"drain_consumer_logs_per_busy_second_min", drainRates.empty() ? "" : fmt::format("{:.0f}", drainRates.front())},
+        {"drain_consumer_logs_per_busy_second_max", drainRates.empty() ? "" : fmt::format("{:.0f}", drainRates.back())},
+        {"allocs_per_log", perLog(run.allocations.allocations)},
+        {"alloc_bytes_per_log", perLog(run.allocations.bytes)},
+        {"producer_allocs_per_log", perLog(run.producerAllocations.allocations)},
+        {"producer_alloc_bytes_per_log", perLog(run.producerAllocations.bytes)},
+        {"allocs_not_freed", config.allocations ? fmt::to_string((long long)(run.allocations.allocations - run.allocations.frees)) : ""},
+    };
+    columns.insert(columns.end(), counters.begin(), counters.end());
+    return columns;
+}
+
+void WriteCSV(std::FILE* out, const std::vector<std::pair<std::string, std::string>> &columns, bool header){
+    if(header){
+        for(size_t i = 0 ; i < columns.size() ; i++){
+            fprintf(out, "%s%s", i == 0 ? "" : ",", columns[i].first.c_str());
+        }
+        fprintf(out, "\n");
+    }
+    for(size_t i = 0 ; i < columns.size() ; i++){
+        fprintf(out, "%s%s", i == 0 ? "" : ",", columns[i].second.c_str());
+    }
+    fprintf(out, "\n");
+}
+
+void WriteJSON(std::FILE* out, const std::vector<std::pair<std::string, std::string>> &columns, bool first){
+    fprintf(out, "%s\n  {", first ? "" : ",");
+    for(size_t i = 0 ; i < columns.size() ; i++){
+        const std::string &value = columns[i].second;
+        bool number = !value.empty() && value.find_first_not_of("0123456789.-") == std::string::npos;
+        fprintf(out, "%s\"%s\": %s%s%s", i == 0 ? "" : ", ", columns[i].first.c_str(), number ? "" : "\"", value.c_str(), number ? "" : "\"");
+    }
+    fprintf(out, "}");
+}
+
+std::vector<std::string> SplitList(const std::string &list){
+    std::vector<std::string> values;
+    std::stringstream stream(list);
+    std::string value;
+    while(std::getline(stream, value, ',')){
+        values.push_back(value);
+    }
+    return values;
+}
+
+/**
+ * @brief Replaces every config by one copy per value, set by set(config, value).
+ */
+template<typename Set>
+void Expand(std::vector<BenchmarkConfig> &configs, const std::string &list, Set set){
+    std::vector<BenchmarkConfig> expanded;
+    for(auto &config : configs){
+        for(auto &value : SplitList(list)){
+            BenchmarkConfig copy = config;
+            set(copy, value);
+            expanded.push_back(copy);
+        }
+    }
+    configs.swap(expanded);
+}
+
+int ParseLevel(const std::string &name){
+    if(name == "all"){
+        return -1;
+    }
+    for(int level = 0 ; level < QuickLogger::LOG_TYPES ; level++){
+        if(QuickLogger::logLevelMessages[level] == name){
+            return level;
+        }
+    }
+    throw std::invalid_argument("unknown level " + name);
+}
+
+void Usage(const char* name){
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "Without options runs the default benchmark and offered load sweep. List options take\n"
+            "comma separated values and every combination of them is run.\n"
+            "  --producers LIST      producer threads (2)\n"
+            "  --consumers LIST      consumer threads (2)\n"
+            "  --mix LIST            argument mix: static, int, float, mixed, string,\n"
+            "                        long_string, many, user (static)\n"
+            "  --size LIST           message length before formatting (7)\n"
+            "  --level LIST          level name or all (all)\n"
+            "  --logger LIST         quick, or the baselines fprintf, mutex, spsc (quick)\n"
+            "  --sink LIST           file, or null, memory, stdout without log files (file)\n"
+            "  --mode tight|rate|burst|consume   back to back or fixed rate Logs, back to back\n"
+            "                        followed by an idle time of --duration-ms, or queued with\n"
+            "                        paused consumers which are then timed alone (tight)\n"
+            "  --iterations N        Logs per run over all producers in tight, burst and consume\n"
+            "                        mode (8e7)\n"
+            "  --rate LIST           Logs per second per producer in rate mode (1e6)\n"
+            "  --arrivals poisson|uniform   arrival process in rate mode (poisson)\n"
+            "  --duration-ms N       run time in rate mode, idle time in burst mode (1000)\n"
+            "  --allocations on|off  count heap allocations per Log (off)\n"
+            "  --counters on|off     perf counters per Log of producers and consumers (off)\n"
+            "  --format text|csv|json       result format (text)\n"
+            "  --output FILE         result file, csv and json default to benchmark.csv/json\n"
+            "The queue type is fixed at build time, e.g. -DQUICK_LOGGER_ENTRIES_PER_NODE=512.\n", name);
+}
+
+int main(int argc, char** argv){
+    int const total_cores = 8;
+
+    if(argc == 1){
+        BenchmarkConfig config;
+        for(auto threads : {2}){
+            config.producers = config.consumers = threads;
+            PrintRun(run_config(config, total_cores));
+        }
+
+        sweep_offered_load(config, total_cores, {2.5e5, 5e5, 1e6, 2e6, 4e6});
 
+        return 0;
+    }
+
+    std::vector<BenchmarkConfig> configs(1);
+    std::string format = "text", output;
+    try{
+        for(int i = 1 ; i < argc ; i++){
+            std::string option = argv[i];
+            if(option == "--help" || i + 1 >= argc){
+                Usage(argv[0]);
+                return option == "--help" ? 0 : 1;
+            }
+            std::string value = argv[++i];
+            if(option == "--producers"){
+                Expand(configs, value, [](BenchmarkConfig &c, const std::string &v){ c.producers = std::stoi(v); });
+            }
+            else if(option == "--consumers"){
+                Expand(configs, value, [](BenchmarkConfig &c, const std::string &v){ c.consumers = std::stoi(v); });
+            }
+            else if(option == "--mix"){
+                Expand(configs, value, [](BenchmarkConfig &c, const std::string &v){
+                    if(std::find(std::begin(MIXES), std::end(MIXES), v) == std::end(MIXES)){
+                        throw std::invalid_argument("unknown mix " + v);
+                    }
+                    c.mix = v;
+                });
+            }
+            else if(option == "--size"){
+                Expand(configs, value, [](BenchmarkConfig &c, const std::string &v){ c.size = std::stoi(v); });
+            }
+            else if(option == "--level"){
+                Expand(configs, value, [](BenchmarkConfig &c, const std::string &v){ c.level = ParseLevel(v); });
+            }
+            else if(option == "--logger"){
+                Expand(configs, value, [](BenchmarkConfig &c, const std::string &v){
+                    if(v != "quick" && !MakeBaselineLogger(v)){
+                        throw std::invalid_argument("unknown logger " + v);
+                    }
+                    c.logger = v;
+                });
+            }
+            else if(option == "--sink"){
+                Expand(configs, value, [](BenchmarkConfig &c, const std::string &v){
+                    if(v != "file" && v != "null" && v != "memory" && v != "stdout"){
+                        throw std::invalid_argument("unknown sink " + v);
+                    }
+                    c.sink = v;
+                });
+            }
+            else if(option == "--rate"){
+                Expand(configs, value, [](BenchmarkConfig &c, const std::string &v){ c.rate = std::stod(v); });
+            }
+            else if(option == "--mode" || option == "--iterations" || option == "--arrivals" || option == "--duration-ms" ||
+                    option == "--allocations" || option == "--counters"){
+                for(auto &c : configs){
+                    if(option == "--mode"){
+                        if(value != "tight" && value != "rate" && value != "burst" && value != "consume"){
+                            throw std::invalid_argument("unknown mode " + value);
+                        }
+                        c.mode = value;
+                    }
+                    else if(option == "--iterations"){
+                        c.iterations = std::stod(value);
+                    }
+                    else if(option == "--arrivals"){
+                        c.arrivals = value == "uniform" ? UNIFORM_ARRIVALS : POISSON_ARRIVALS;
+                    }
+                    else if(option == "--allocations"){
+                        c.allocations = value == "on";
+                    }
+                    else if(option == "--counters"){
+                        c.counters = value == "on";
+                    }
+                    else{
+                        c.duration = std::chrono::milliseconds(std::stol(value));
+                    }
+                }
+            }
+            else if(option == "--format"){
+                format = value;
+            }
+            else if(option == "--output"){
+                output = value;
+            }
+            else{
+                Usage(argv[0]);
+                return 1;
+            }
+        }
+    }
+    catch(const std::exception &e){
+        fprintf(stderr, "Invalid argument: %s\n", e.what());
+        return 1;
+    }
+
+    if(format != "text" && format != "csv" && format != "json"){
+        Usage(argv[0]);
+        return 1;
+    }
+    // The Logger prints to STDOUT when it starts and stops, so structured results go to a file.
+    if(output.empty() && format != "text"){
+        output = "benchmark." + format;
+    }
+    std::FILE* out = output.empty() ? stdout : std::fopen(output.c_str(), "w");
+    if(out == nullptr){
+        fprintf(stderr, "Unable to open %s\n", output.c_str());
+        return 1;
+    }
+
+    // The SPSC ring takes a single producer, the baselines only write files and cannot pause.
+    configs.erase(std::remove_if(configs.begin(), configs.end(), [](const BenchmarkConfig &c){
+        if(c.logger == "spsc" && c.producers != 1){
+            fprintf(stderr, "Skipping spsc with %d producers\n", c.producers);
+            return true;
+        }
+        if(c.logger != "quick" && (c.sink != "file" || c.mode == "consume")){
+            fprintf(stderr, "Skipping %s with the %s sink in %s mode\n", c.logger.c_str(), c.sink.c_str(), c.mode.c_str());
+            return true;
+        }
+        return false;
+    }), configs.end());
+
+    // The brackets are written around the loop, so an empty matrix still gives a valid array.
+    if(format == "json"){
+        fprintf(out, "[");
+    }
+    for(size_t i = 0 ; i < configs.size() ; i++){
+        const BenchmarkConfig &config = configs[i];
+        RunResult run = run_config(config, total_cores);
+        auto columns = ResultColumns(config, run);
+        if(format == "csv"){
+            WriteCSV(out, columns, i == 0);
+        }
+        else if(format == "json"){
+            WriteJSON(out, columns, i == 0);
+        }
+        else{
+            fprintf(out, "\n");
+            for(auto &column : columns){
+                fprintf(out, "%s=%s ", column.first.c_str(), column.second.c_str());
+            }
+            fprintf(out, "\n");
+            fflush(out);
+            PrintRun(run);
+        }
+        fflush(out);
+    }
+    if(format == "json"){
+        fprintf(out, "\n]\n");
+    }
+    if(out != stdout){
+        fclose(out);
+    }
     return 0;
-}
\ No newline at end of file
+}
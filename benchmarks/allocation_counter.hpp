@@ -0,0 +1,239 @@
+#ifndef QUICK_LOGGER_ALLOCATION_COUNTER_H
+#define QUICK_LOGGER_ALLOCATION_COUNTER_H
+
+/**
+ * @brief Counting replacement of the global operator new and delete for the benchmarks.
+ *
+ * Defines the replaceable allocation functions, so it must be included by exactly one
+ * translation unit of a program. Counting is off until AllocationCounter::enabled is set;
+ * while it is off every allocation only pays for one relaxed load. Each thread counts into
+ * its own cache line aligned slot. A thread gives its slot back when it exits, after adding
+ * its counts to the retired totals, so a long benchmark matrix keeps reusing the slots.
+ * Threads beyond the MAX_THREADS - 1 alive at the same time, and threads which allocate
+ * after their slot was given back while exiting, share the last slot; they cannot be told
+ * apart as producers, which sets overflowed.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <malloc.h>
+
+namespace AllocationCounter {
+
+struct alignas(64) Slot {
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> frees{0};
+    std::atomic<bool>     producer{false};
+};
+
+/**
+ * @brief Allocation counts summed over a group of threads.
+ */
+struct Totals {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    uint64_t frees = 0;
+};
+
+static const int MAX_THREADS = 1024;
+static const int SHARED_SLOT = MAX_THREADS - 1;
+
+inline std::atomic<bool> enabled{false};
+inline Slot              slots[MAX_THREADS];
+inline std::atomic<bool> taken[MAX_THREADS];
+inline std::atomic<int>  usedSlots{0};
+inline std::atomic<bool> overflowed{false};
+// Counts of the threads which exited, of all of them and of the producers among them.
+inline Slot              retired;
+inline Slot              retiredProducers;
+
+/**
+ * @brief Takes a free slot, or the shared one if all are taken.
+ */
+inline int Acquire(){
+    for(int i = 0 ; i < SHARED_SLOT ; i++){
+        bool expected = false;
+        if(!taken[i].load(std::memory_order_relaxed) && taken[i].compare_exchange_strong(expected, true)){
+            int used = usedSlots.load(std::memory_order_relaxed);
+            while(used < i + 1 && !usedSlots.compare_exchange_weak(used, i + 1)){}
+            return i;
+        }
+    }
+    overflowed.store(true, std::memory_order_relaxed);
+    return SHARED_SLOT;
+}
+
+/**
+ * @brief Moves the counts of a slot to the retired totals and frees it.
+ */
+inline void Release(int index){
+    if(index < 0 || index == SHARED_SLOT){
+        return;
+    }
+    Slot &slot = slots[index];
+    bool producer = slot.producer.exchange(false, std::memory_order_relaxed);
+    uint64_t allocations = slot.allocations.exchange(0, std::memory_order_relaxed);
+    uint64_t bytes = slot.bytes.exchange(0, std::memory_order_relaxed);
+    uint64_t frees = slot.frees.exchange(0, std::memory_order_relaxed);
+    auto add = [&](Slot &totals){
+        totals.allocations.fetch_add(allocations, std::memory_order_relaxed);
+        totals.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        totals.frees.fetch_add(frees, std::memory_order_relaxed);
+    };
+    add(retired);
+    if(producer){
+        add(retiredProducers);
+    }
+    taken[index].store(false, std::memory_order_release);
+}
+
+/**
+ * @brief The slot of a thread, given back by its thread_local destructor.
+ */
+struct SlotOwner {
+    int index = -1;
+    ~SlotOwner();
+};
+
+// Trivially destructible, so still readable while the other thread_local objects are destroyed.
+inline thread_local bool      exited = false;
+inline thread_local SlotOwner owner;
+
+inline SlotOwner::~SlotOwner(){
+    exited = true;
+    Release(index);
+    index = -1;
+}
+
+inline Slot &Local(){
+    if(exited){
+        return slots[SHARED_SLOT];
+    }
+    if(owner.index < 0){
+        owner.index = Acquire();
+    }
+    return slots[owner.index];
+}
+
+inline void Allocated(void* pointer){
+    if(pointer != nullptr && enabled.load(std::memory_order_relaxed)){
+        Slot &slot = Local();
+        slot.allocations.fetch_add(1, std::memory_order_relaxed);
+        slot.bytes.fetch_add(malloc_usable_size(pointer), std::memory_order_relaxed);
+    }
+}
+
+inline void Freed(void* pointer){
+    if(pointer != nullptr && enabled.load(std::memory_order_relaxed)){
+        Local().frees.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Marks the calling thread as a producer, see Sum.
+ *
+ * A thread on the shared slot cannot be marked, its counts stay with the other threads.
+ */
+inline void MarkProducer(){
+    Slot &slot = Local();
+    if(&slot == &slots[SHARED_SLOT]){
+        overflowed.store(true, std::memory_order_relaxed);
+        return;
+    }
+    slot.producer.store(true, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Sums the counts of all threads, or only of the producer threads.
+ */
+inline Totals Sum(bool producersOnly = false){
+    Totals totals;
+    auto add = [&totals](const Slot &slot){
+        totals.allocations += slot.allocations.load(std::memory_order_relaxed);
+        totals.bytes += slot.bytes.load(std::memory_order_relaxed);
+        totals.frees += slot.frees.load(std::memory_order_relaxed);
+    };
+    add(producersOnly ? retiredProducers : retired);
+    int count = usedSlots.load(std::memory_order_relaxed);
+    for(int i = 0 ; i < count ; i++){
+        if(!producersOnly || slots[i].producer.load(std::memory_order_relaxed)){
+            add(slots[i]);
+        }
+    }
+    if(!producersOnly){
+        add(slots[SHARED_SLOT]);
+    }
+    return totals;
+}
+
+inline void* Allocate(std::size_t size){
+    void* pointer = std::malloc(size == 0 ? 1 : size);
+    Allocated(pointer);
+    return pointer;
+}
+
+inline void* AllocateAligned(std::size_t size, std::align_val_t alignment){
+    std::size_t align = static_cast<std::size_t>(alignment);
+    void* pointer = std::aligned_alloc(align, (size + align - 1) / align * align);
+    Allocated(pointer);
+    return pointer;
+}
+
+// Not inlined into the replaced operator delete, GCC would take the free for a mismatched one.
+__attribute__((noinline)) inline void Free(void* pointer){
+    Freed(pointer);
+    std::free(pointer);
+}
+
+}
+
+void* operator new(std::size_t size){
+    void* pointer = AllocationCounter::Allocate(size);
+    if(pointer == nullptr){
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+void* operator new[](std::size_t size){
+    return operator new(size);
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return AllocationCounter::Allocate(size);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return AllocationCounter::Allocate(size);
+}
+void* operator new(std::size_t size, std::align_val_t alignment){
+    void* pointer = AllocationCounter::AllocateAligned(size, alignment);
+    if(pointer == nullptr){
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+void* operator new[](std::size_t size, std::align_val_t alignment){
+    return operator new(size, alignment);
+}
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return AllocationCounter::AllocateAligned(size, alignment);
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return AllocationCounter::AllocateAligned(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept { AllocationCounter::Free(pointer); }
+void operator delete[](void* pointer) noexcept { AllocationCounter::Free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { AllocationCounter::Free(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { AllocationCounter::Free(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { AllocationCounter::Free(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { AllocationCounter::Free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { AllocationCounter::Free(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { AllocationCounter::Free(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { AllocationCounter::Free(pointer); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept { AllocationCounter::Free(pointer); }
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { AllocationCounter::Free(pointer); }
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { AllocationCounter::Free(pointer); }
+
+#endif
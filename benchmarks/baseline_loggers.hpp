@@ -0,0 +1,267 @@
+#ifndef QUICK_LOGGER_BASELINE_LOGGERS_H
+#define QUICK_LOGGER_BASELINE_LOGGERS_H
+
+/**
+ * @brief Simple loggers the benchmark compares QuickLogger against.
+ *
+ * They build the same Log objects with the same deferred formatting as QuickLogger::LogItem
+ * and render the same text lines into one file per level, so only the way Logs get from the
+ * producers to the output differs:
+ *
+ *  fprintf   every producer formats and writes its Log itself under one lock
+ *  mutex     producers append to a std::deque under a std::mutex, one consumer thread writes
+ *  spsc      one producer pushes into a bounded single producer single consumer ring, one
+ *            consumer thread writes; the producer spins while the ring is full
+ */
+
+#include "../QuickLogger.hpp"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+
+/**
+ * @brief Base class of the baseline loggers with the LogItem interface of QuickLogger.
+ *
+ * Attributes:
+ *  * outputFiles
+ *    One file per level in the directory of the logger.
+ *  * written
+ *    Logs written per level, only updated by the thread writing.
+ */
+class BaselineLogger {
+    public:
+    virtual ~BaselineLogger(){
+        CloseFiles();
+    }
+
+    /**
+     * @brief Opens the output files and starts the consumer threads, if any.
+     *
+     * @param directory         Directory for the log files, created if missing
+     * @param consumers         Requested number of consumers, the baselines use at most one
+     */
+    virtual void Start(const std::filesystem::path &directory, int){
+        std::filesystem::create_directories(directory);
+        for(int i = 0 ; i < QuickLogger::LOG_TYPES ; i++){
+            outputFiles[i] = std::fopen((directory / (QuickLogger::logLevelMessages[i] + ".log")).c_str(), "a");
+            written[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Writes all queued Logs, stops the consumer threads and closes the files.
+     */
+    virtual void Stop(){
+        CloseFiles();
+    }
+
+    /**
+     * @brief Hands a Log to the logger, which takes ownership of it.
+     */
+    virtual bool Push(QuickLogger::Log* log, int queue) = 0;
+
+    template<typename T, typename ...P>
+    bool LogItem(int level, int queue, T &&value, P&&... parameters){
+        QuickLogger::Log* l = new QuickLogger::Log();
+        l->value = std::string(value);
+        l->logLevel = level;
+        l->time = std::chrono::system_clock::now();
+        l->parameterFlag = sizeof...(P) > 0;
+        if(l->parameterFlag){
+            l->saved_op = l->BuildOperation(std::forward<P>(parameters)...);
+        }
+        return Push(l, queue);
+    }
+
+    QuickLogger::LoggerMetrics metrics() const {
+        QuickLogger::LoggerMetrics m;
+        for(int i = 0 ; i < QuickLogger::LOG_TYPES ; i++){
+            m.written[i] = written[i].load(std::memory_order_relaxed);
+        }
+        return m;
+    }
+
+    protected:
+    std::FILE*             outputFiles[QuickLogger::LOG_TYPES] = {};
+    std::atomic<u_int64_t> written[QuickLogger::LOG_TYPES] = {};
+
+    /**
+     * @brief Formats, renders and writes one Log, then deletes it.
+     */
+    void Write(QuickLogger::Log* log, const std::string &id){
+        if(log->parameterFlag){
+            log->saved_op(log);
+        }
+        std::string line = QuickLogger::QuickLogger::FormatTime(log) + "\t\tThread ID : " + id + "\t" + log->value + "\n";
+        std::fwrite(line.data(), 1, line.size(), outputFiles[log->logLevel]);
+        written[log->logLevel].store(written[log->logLevel].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        delete log;
+    }
+
+    void CloseFiles(){
+        for(auto &file : outputFiles){
+            if(file != nullptr){
+                std::fclose(file);
+                file = nullptr;
+            }
+        }
+    }
+};
+
+/**
+ * @brief Synchronous logger, the producer writes its Log itself while holding a lock.
+ */
+class FprintfLogger : public BaselineLogger {
+    public:
+    bool Push(QuickLogger::Log* log, int queue) override {
+        std::string id = fmt::to_string(queue);
+        std::lock_guard<std::mutex> guard(lock);
+        Write(log, id);
+        return true;
+    }
+
+    private:
+    std::mutex lock;
+};
+
+/**
+ * @brief std::deque guarded by a std::mutex with one consumer thread.
+ *
+ * The consumer swaps the whole deque out under the lock and writes the batch without it.
+ */
+class MutexQueueLogger : public BaselineLogger {
+    public:
+    void Start(const std::filesystem::path &directory, int consumers) override {
+        BaselineLogger::Start(directory, consumers);
+        terminate = false;
+        consumer = std::thread(&MutexQueueLogger::Consume, this);
+    }
+
+    void Stop() override {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            terminate = true;
+        }
+        ready.notify_one();
+        consumer.join();
+        BaselineLogger::Stop();
+    }
+
+    bool Push(QuickLogger::Log* log, int) override {
+        bool notify;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            logs.push_back(log);
+            notify = waiting;
+        }
+        if(notify){
+            ready.notify_one();
+        }
+        return true;
+    }
+
+    private:
+    std::mutex                     lock;
+    std::condition_variable        ready;
+    std::deque<QuickLogger::Log*>  logs;
+    bool                           waiting = false;
+    bool                           terminate = false;
+    std::thread                    consumer;
+
+    void Consume(){
+        std::deque<QuickLogger::Log*> batch;
+        const std::string id = "0";
+        while(true){
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                waiting = true;
+                ready.wait(guard, [this]{ return !logs.empty() || terminate; });
+                waiting = false;
+                if(logs.empty() && terminate){
+                    return;
+                }
+                batch.swap(logs);
+            }
+            for(auto log : batch){
+                Write(log, id);
+            }
+            batch.clear();
+        }
+    }
+};
+
+/**
+ * @brief Bounded single producer single consumer ring with one consumer thread.
+ *
+ * Only valid with a single producer thread. The consumer polls like the QuickLogger consumers.
+ */
+class SpscRingLogger : public BaselineLogger {
+    public:
+    static const size_t CAPACITY = 1 << 16;
+
+    void Start(const std::filesystem::path &directory, int consumers) override {
+        BaselineLogger::Start(directory, consumers);
+        terminate = false;
+        consumer = std::thread(&SpscRingLogger::Consume, this);
+    }
+
+    void Stop() override {
+        terminate = true;
+        consumer.join();
+        BaselineLogger::Stop();
+    }
+
+    bool Push(QuickLogger::Log* log, int) override {
+        u_int64_t position = tail.load(std::memory_order_relaxed);
+        while(position - head.load(std::memory_order_acquire) >= CAPACITY){
+        }
+        ring[position & (CAPACITY - 1)] = log;
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    private:
+    std::unique_ptr<QuickLogger::Log*[]> ring{new QuickLogger::Log*[CAPACITY]};
+    alignas(64) std::atomic<u_int64_t>   head{0};
+    alignas(64) std::atomic<u_int64_t>   tail{0};
+    alignas(64) std::atomic<bool>        terminate{false};
+    std::thread                          consumer;
+
+    void Consume(){
+        const std::string id = "0";
+        while(true){
+            bool terminating = terminate.load();
+            u_int64_t position = head.load(std::memory_order_relaxed);
+            u_int64_t end = tail.load(std::memory_order_acquire);
+            if(position == end){
+                if(terminating){
+                    return;
+                }
+                continue;
+            }
+            for( ; position != end ; position++){
+                Write(ring[position & (CAPACITY - 1)], id);
+            }
+            head.store(position, std::memory_order_release);
+        }
+    }
+};
+
+/**
+ * @brief Returns the baseline logger with the given name, nullptr for an unknown name.
+ */
+inline std::unique_ptr<BaselineLogger> MakeBaselineLogger(const std::string &name){
+    if(name == "fprintf"){
+        return std::unique_ptr<BaselineLogger>(new FprintfLogger());
+    }
+    if(name == "mutex"){
+        return std::unique_ptr<BaselineLogger>(new MutexQueueLogger());
+    }
+    if(name == "spsc"){
+        return std::unique_ptr<BaselineLogger>(new SpscRingLogger());
+    }
+    return nullptr;
+}
+
+#endif
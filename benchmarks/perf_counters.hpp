@@ -0,0 +1,146 @@
+#ifndef QUICK_LOGGER_PERF_COUNTERS_H
+#define QUICK_LOGGER_PERF_COUNTERS_H
+
+/**
+ * @brief Hardware and software performance counters of the benchmark threads.
+ *
+ * Opens one perf_event_open counter per event, each on its own so that an event the machine or
+ * the permissions do not allow leaves the others working. The hardware counters only count
+ * user space (exclude_kernel), which perf_event_paranoid 2, the usual default, allows to
+ * unprivileged users; context switches happen in the kernel and are counted there. Events
+ * which cannot be opened, e.g. hardware events in a VM without a virtual PMU, read as -1.
+ */
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * @brief Counts of the PerfCounters events, -1 where an event was not available.
+ */
+struct PerfCounts {
+    static const int EVENTS = 5;
+
+    int64_t value[EVENTS] = {-1, -1, -1, -1, -1};
+
+    bool available() const {
+        for(auto v : value){
+            if(v >= 0){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    PerfCounts &operator+=(const PerfCounts &other){
+        for(int i = 0 ; i < EVENTS ; i++){
+            value[i] = value[i] < 0 || other.value[i] < 0 ? -1 : value[i] + other.value[i];
+        }
+        return *this;
+    }
+
+    PerfCounts operator-(const PerfCounts &other) const {
+        PerfCounts difference;
+        for(int i = 0 ; i < EVENTS ; i++){
+            difference.value[i] = value[i] < 0 || other.value[i] < 0 ? -1 : value[i] - other.value[i];
+        }
+        return difference;
+    }
+};
+
+/**
+ * @brief perf_event_open counters of the calling thread, optionally of the threads it creates.
+ *
+ * Attributes:
+ *  * NAMES
+ *    Column names of the events, in the order of PerfCounts::value.
+ *  * fds
+ *    File descriptor per event, -1 if it could not be opened.
+ *  * error
+ *    errno of the first counter which could not be opened, 0 if all opened.
+ */
+class PerfCounters {
+    public:
+    static constexpr const char* NAMES[PerfCounts::EVENTS] = {"cycles", "instructions", "cache_misses", "branch_misses", "context_switches"};
+
+    PerfCounters(){}
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters &operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters(){
+        Close();
+    }
+
+    /**
+     * @brief Opens and starts the counters on the calling thread.
+     *
+     * @param inherit           Also count the threads the calling thread creates from now on.
+     *                          Their counts are added when they exit.
+     * @return                  `true` if at least one counter was opened
+     */
+    bool Open(bool inherit = false){
+        static const uint32_t types[PerfCounts::EVENTS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+                                                           PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE};
+        static const uint64_t configs[PerfCounts::EVENTS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                             PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES,
+                                                             PERF_COUNT_SW_CONTEXT_SWITCHES};
+        Close();
+        error = 0;
+        bool opened = false;
+        for(int i = 0 ; i < PerfCounts::EVENTS ; i++){
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = types[i];
+            attr.config = configs[i];
+            attr.exclude_kernel = types[i] == PERF_TYPE_HARDWARE ? 1 : 0;
+            attr.exclude_hv = 1;
+            attr.inherit = inherit ? 1 : 0;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+            if(fds[i] < 0 && error == 0){
+                error = errno;
+            }
+            opened = opened || fds[i] >= 0;
+        }
+        return opened;
+    }
+
+    /**
+     * @brief Reads the counters, scaled up for the time they were multiplexed out.
+     */
+    PerfCounts Read() const {
+        PerfCounts counts;
+        for(int i = 0 ; i < PerfCounts::EVENTS ; i++){
+            uint64_t data[3];
+            if(fds[i] < 0 || read(fds[i], data, sizeof(data)) != sizeof(data)){
+                continue;
+            }
+            counts.value[i] = data[2] > 0 && data[2] < data[1] ? (int64_t)((double)data[0] * data[1] / data[2]) : (int64_t)data[0];
+        }
+        return counts;
+    }
+
+    bool isOpen(int event) const {
+        return fds[event] >= 0;
+    }
+
+    void Close(){
+        for(auto &fd : fds){
+            if(fd >= 0){
+                close(fd);
+                fd = -1;
+            }
+        }
+    }
+
+    int error = 0;
+
+    private:
+    int fds[PerfCounts::EVENTS] = {-1, -1, -1, -1, -1};
+};
+
+#endif
@@ -0,0 +1,356 @@
+/**
+ * @brief Microbenchmark of the queue layer alone, without formatting or I/O.
+ *
+ * P producers push pointers into one shared queue and C consumers pop them, for every queue
+ * variant and every combination of producer and consumer counts. Each push and each
+ * successful pop is timed with the TSC, so the latencies include about one clock read
+ * (~10 ns). Every row reports the throughput from the first push to the last pop, push and
+ * pop latency percentiles and how often a bounded queue was full.
+ *
+ *  ramalhete/<reclaimer>/<entries>  the unbounded queue of the Logger, with the given
+ *                                   reclaimer and entries per node
+ *  scq/<capacity>                   bounded queue of two nikolaev_scq index rings
+ *  spsc/<capacity>                  single producer single consumer ring, 1x1 only
+ *  mutex                            std::deque guarded by a std::mutex
+ *
+ * Usage: queue_benchmark [--queue LIST] [--producers LIST] [--consumers LIST] [--items N]
+ *                        [--format text|csv]
+ */
+#include "../QuickLogger.hpp"
+#include "xenium/detail/nikolaev_scq.hpp"
+#include <cstdio>
+#include <sstream>
+
+
+struct Item {
+    uint64_t value;
+};
+
+/**
+ * @brief Adapts a xenium::ramalhete_queue to the push/pop interface of the benchmark.
+ */
+template<typename Reclaimer, unsigned EntriesPerNode>
+class RamalheteQueue {
+    public:
+    bool push(Item* item){
+        queue.push(item);
+        return true;
+    }
+    bool pop(Item* &item){
+        return queue.try_pop(item);
+    }
+
+    private:
+    xenium::ramalhete_queue<Item*, xenium::policy::reclaimer<Reclaimer>, xenium::policy::entries_per_node<EntriesPerNode>> queue;
+};
+
+/**
+ * @brief Bounded MPMC queue built from two nikolaev_scq rings of slot indices.
+ *
+ * free holds the indices of the empty slots and allocated the indices of the filled ones, a push
+ * takes an index from free, stores the item and hands the index to allocated.
+ */
+template<size_t Capacity>
+class ScqQueue {
+    public:
+    static const size_t POP_RETRIES = 1000;
+
+    ScqQueue() :
+        remapShift(xenium::detail::nikolaev_scq::calc_remap_shift(Capacity)),
+        slots(new Item*[Capacity]),
+        allocated(Capacity, remapShift, xenium::detail::nikolaev_scq::empty_tag{}),
+        free(Capacity, remapShift, xenium::detail::nikolaev_scq::full_tag{}) {}
+
+    bool push(Item* item){
+        uint64_t index;
+        if(!free.dequeue<false, POP_RETRIES>(index, Capacity, remapShift)){
+            return false;
+        }
+        slots[index] = item;
+        allocated.enqueue<false, false>(index, Capacity, remapShift);
+        return true;
+    }
+    bool pop(Item* &item){
+        uint64_t index;
+        if(!allocated.dequeue<false, POP_RETRIES>(index, Capacity, remapShift)){
+            return false;
+        }
+        item = slots[index];
+        free.enqueue<false, false>(index, Capacity, remapShift);
+        return true;
+    }
+
+    private:
+    size_t                          remapShift;
+    std::unique_ptr<Item*[]>        slots;
+    xenium::detail::nikolaev_scq    allocated;
+    xenium::detail::nikolaev_scq    free;
+};
+
+/**
+ * @brief Bounded single producer single consumer ring.
+ */
+template<size_t Capacity>
+class SpscQueue {
+    public:
+    bool push(Item* item){
+        uint64_t position = tail.load(std::memory_order_relaxed);
+        if(position - head.load(std::memory_order_acquire) >= Capacity){
+            return false;
+        }
+        ring[position & (Capacity - 1)] = item;
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+    bool pop(Item* &item){
+        uint64_t position = head.load(std::memory_order_relaxed);
+        if(position == tail.load(std::memory_order_acquire)){
+            return false;
+        }
+        item = ring[position & (Capacity - 1)];
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    private:
+    std::unique_ptr<Item*[]>           ring{new Item*[Capacity]};
+    alignas(64) std::atomic<uint64_t>  head{0};
+    alignas(64) std::atomic<uint64_t>  tail{0};
+};
+
+/**
+ * @brief std::deque guarded by a std::mutex, one item per lock.
+ */
+class MutexQueue {
+    public:
+    bool push(Item* item){
+        std::lock_guard<std::mutex> guard(lock);
+        items.push_back(item);
+        return true;
+    }
+    bool pop(Item* &item){
+        std::lock_guard<std::mutex> guard(lock);
+        if(items.empty()){
+            return false;
+        }
+        item = items.front();
+        items.pop_front();
+        return true;
+    }
+
+    private:
+    std::mutex          lock;
+    std::deque<Item*>   items;
+};
+
+/**
+ * @brief Results of one run of one queue.
+ *
+ * Every thread fills its own QueueResult inside the timed loop, the alignment keeps
+ * neighbouring results in a vector off each other's cache lines.
+ */
+struct alignas(64) QueueResult {
+    QuickLogger::Histogram push;
+    QuickLogger::Histogram pop;
+    uint64_t               pushed = 0;
+    uint64_t               popped = 0;
+    uint64_t               full = 0;
+    uint64_t               nanoseconds = 0;
+};
+
+/**
+ * @brief Runs producers and consumers on a new queue until all items went through it.
+ */
+template<typename Queue>
+QueueResult RunQueue(int producers, int consumers, uint64_t items){
+    std::unique_ptr<Queue> queue(new Queue());
+    std::vector<QueueResult> results(producers + consumers);
+    std::atomic<bool> start{false}, done{false};
+    std::vector<std::thread> producerThreads, consumerThreads;
+
+    for(int p = 0 ; p < producers ; p++){
+        producerThreads.emplace_back([&, p]{
+            QueueResult &result = results[p];
+            Item item{(uint64_t)p};
+            uint64_t count = items / producers + (p < (int)(items % producers) ? 1 : 0);
+            while(!start.load()){
+            }
+            for(uint64_t i = 0 ; i < count ; i++){
+                uint64_t begin = QuickLogger::TscClock::now();
+                while(!queue->push(&item)){
+                    result.full++;
+                }
+                result.push.record(QuickLogger::TscClock::now() - begin);
+            }
+            result.pushed = count;
+        });
+    }
+    for(int c = 0 ; c < consumers ; c++){
+        consumerThreads.emplace_back([&, c]{
+            QueueResult &result = results[producers + c];
+            Item* item;
+            while(!start.load()){
+            }
+            while(true){
+                // All pushes completed before done was set, so an empty queue after it stays empty.
+                bool finished = done.load();
+                uint64_t begin = QuickLogger::TscClock::now();
+                if(queue->pop(item)){
+                    result.pop.record(QuickLogger::TscClock::now() - begin);
+                    result.popped++;
+                }
+                else if(finished){
+                    break;
+                }
+            }
+        });
+    }
+
+    uint64_t begin = QuickLogger::TscClock::now();
+    start.store(true);
+    for(auto &thread : producerThreads){
+        thread.join();
+    }
+    done.store(true);
+    for(auto &thread : consumerThreads){
+        thread.join();
+    }
+    QueueResult total;
+    total.nanoseconds = QuickLogger::TscClock::ToNanoseconds(QuickLogger::TscClock::now() - begin);
+    for(auto &result : results){
+        total.push.merge(result.push);
+        total.pop.merge(result.pop);
+        total.pushed += result.pushed;
+        total.popped += result.popped;
+        total.full += result.full;
+    }
+    return total;
+}
+
+typedef QueueResult (*QueueRunner)(int, int, uint64_t);
+
+static const std::pair<const char*, QueueRunner> QUEUES[] = {
+    {"ramalhete/ebr/2048", RunQueue<RamalheteQueue<xenium::reclamation::epoch_based<>, 2048>>},
+    {"ramalhete/ebr/512", RunQueue<RamalheteQueue<xenium::reclamation::epoch_based<>, 512>>},
+    {"ramalhete/ebr/128", RunQueue<RamalheteQueue<xenium::reclamation::epoch_based<>, 128>>},
+    {"ramalhete/nebr/2048", RunQueue<RamalheteQueue<xenium::reclamation::new_epoch_based<>, 2048>>},
+    {"ramalhete/debra/2048", RunQueue<RamalheteQueue<xenium::reclamation::debra<>, 2048>>},
+    {"scq/65536", RunQueue<ScqQueue<1 << 16>>},
+    {"spsc/65536", RunQueue<SpscQueue<1 << 16>>},
+    {"mutex", RunQueue<MutexQueue>},
+};
+
+std::vector<std::string> SplitList(const std::string &list){
+    std::vector<std::string> values;
+    std::stringstream stream(list);
+    std::string value;
+    while(std::getline(stream, value, ',')){
+        values.push_back(value);
+    }
+    return values;
+}
+
+void Usage(const char* name){
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --queue LIST          queues to run (all):\n", name);
+    for(auto &queue : QUEUES){
+        fprintf(stderr, "                          %s\n", queue.first);
+    }
+    fprintf(stderr,
+            "  --producers LIST      producer threads (1,2,4)\n"
+            "  --consumers LIST      consumer threads (1,2,4)\n"
+            "  --items N             items per run over all producers (1e7)\n"
+            "  --format text|csv     result format (text)\n");
+}
+
+int main(int argc, char** argv){
+    std::vector<std::string> queues;
+    std::vector<int> producerCounts = {1, 2, 4}, consumerCounts = {1, 2, 4};
+    uint64_t items = 1e7;
+    std::string format = "text";
+    try{
+        for(int i = 1 ; i < argc ; i++){
+            std::string option = argv[i];
+            if(option == "--help" || i + 1 >= argc){
+                Usage(argv[0]);
+                return option == "--help" ? 0 : 1;
+            }
+            std::string value = argv[++i];
+            if(option == "--queue"){
+                queues = SplitList(value);
+            }
+            else if(option == "--producers" || option == "--consumers"){
+                std::vector<int> &counts = option == "--producers" ? producerCounts : consumerCounts;
+                counts.clear();
+                for(auto &count : SplitList(value)){
+                    counts.push_back(std::stoi(count));
+                }
+            }
+            else if(option == "--items"){
+                items = std::stod(value);
+            }
+            else if(option == "--format" && (value == "text" || value == "csv")){
+                format = value;
+            }
+            else{
+                Usage(argv[0]);
+                return 1;
+            }
+        }
+    }
+    catch(const std::exception &e){
+        fprintf(stderr, "Invalid argument: %s\n", e.what());
+        return 1;
+    }
+    for(auto &name : queues){
+        if(std::none_of(std::begin(QUEUES), std::end(QUEUES), [&](const std::pair<const char*, QueueRunner> &q){ return name == q.first; })){
+            fprintf(stderr, "Unknown queue %s\n", name.c_str());
+            return 1;
+        }
+    }
+
+    QuickLogger::TscClock::Calibrate();
+    auto ns = [](uint64_t ticks){ return (unsigned long long)QuickLogger::TscClock::ToNanoseconds(ticks); };
+    if(format == "csv"){
+        printf("queue,producers,consumers,items,seconds,items_per_second,full,push_p50_ns,push_p99_ns,push_p999_ns,push_max_ns,"
+               "pop_p50_ns,pop_p99_ns,pop_p999_ns,pop_max_ns\n");
+    }
+    else{
+        printf("%-22s %3s %3s %14s %8s %8s %8s %10s %8s %8s %8s %10s %10s\n", "queue", "P", "C", "items/s", "push p50", "p99",
+               "p99.9", "max", "pop p50", "p99", "p99.9", "max", "full");
+    }
+    for(auto &queue : QUEUES){
+        if(!queues.empty() && std::find(queues.begin(), queues.end(), queue.first) == queues.end()){
+            continue;
+        }
+        for(int producers : producerCounts){
+            for(int consumers : consumerCounts){
+                if(std::strncmp(queue.first, "spsc", 4) == 0 && (producers != 1 || consumers != 1)){
+                    continue;
+                }
+                QueueResult result = queue.second(producers, consumers, items);
+                if(result.popped != result.pushed){
+                    fprintf(stderr, "%s: %llu items pushed but %llu popped\n", queue.first,
+                            (unsigned long long)result.pushed, (unsigned long long)result.popped);
+                }
+                double throughput = result.nanoseconds > 0 ? result.popped * 1e9 / result.nanoseconds : 0;
+                const QuickLogger::Histogram &push = result.push, &pop = result.pop;
+                if(format == "csv"){
+                    printf("%s,%d,%d,%llu,%.6f,%.0f,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n", queue.first, producers, consumers,
+                           (unsigned long long)result.popped, result.nanoseconds / 1e9, throughput, (unsigned long long)result.full,
+                           ns(push.percentile(0.5)), ns(push.percentile(0.99)), ns(push.percentile(0.999)), ns(push.max()),
+                           ns(pop.percentile(0.5)), ns(pop.percentile(0.99)), ns(pop.percentile(0.999)), ns(pop.max()));
+                }
+                else{
+                    printf("%-22s %3d %3d %14.0f %8llu %8llu %8llu %10llu %8llu %8llu %8llu %10llu %10llu\n", queue.first, producers,
+                           consumers, throughput, ns(push.percentile(0.5)), ns(push.percentile(0.99)), ns(push.percentile(0.999)),
+                           ns(push.max()), ns(pop.percentile(0.5)), ns(pop.percentile(0.99)), ns(pop.percentile(0.999)), ns(pop.max()),
+                           (unsigned long long)result.full);
+                }
+                fflush(stdout);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,368 @@
+/**
+ * @brief Microbenchmarks of the stages a Log goes through, each on its own.
+ *
+ * Every stage runs in rounds: an untimed setup prepares a batch of inputs, then the whole batch
+ * is run between two TSC reads and the time per operation is the round's result. After one
+ * warm up round the median, minimum and 90th percentile over all rounds are reported, which
+ * stay stable from run to run where single call timings would be dominated by the clock reads.
+ *
+ *  build_operation/<args>  Log::BuildOperation, capturing the arguments of a LogItem call
+ *  log_new, log_delete     allocating and freeing a Log
+ *  system_clock, tsc       the timestamp LogItem takes and the TscClock read
+ *  queue_push, queue_pop   LogQueue push and try_pop on one thread, no contention
+ *  do_operation/<args>     the deferred formatting of the consumer (saved_op)
+ *  format_time             QuickLogger::FormatTime
+ *  render_line             QuickLogger::RenderLine, i.e. format_time and the line assembly
+ *  sink_file, sink_null, sink_memory   writing the rendered line to a file (as the consumers
+ *                          do), a NullSink and a MemorySink
+ *
+ * Usage: stage_benchmark [--stage LIST] [--rounds N] [--batch N] [--cpu N] [--format text|csv]
+ */
+#include "../QuickLogger.hpp"
+#include <cstdio>
+#include <sstream>
+
+
+/**
+ * @brief Keeps the compiler from dropping the computation of a result which is never read.
+ */
+template<typename T>
+inline void Escape(T* pointer){
+    asm volatile("" : : "g"(pointer) : "memory");
+}
+
+/**
+ * @brief One stage: setup(batch) prepares a round untimed, run(batch) is timed.
+ */
+struct Stage {
+    std::string                 name;
+    std::function<void(size_t)> setup;
+    std::function<void(size_t)> run;
+};
+
+struct StageResult {
+    double median = 0;
+    double minimum = 0;
+    double p90 = 0;
+};
+
+StageResult RunStage(const Stage &stage, int rounds, size_t batch){
+    std::vector<double> perOperation;
+    for(int round = 0 ; round <= rounds ; round++){
+        stage.setup(batch);
+        uint64_t begin = QuickLogger::TscClock::now();
+        stage.run(batch);
+        uint64_t end = QuickLogger::TscClock::now();
+        if(round > 0){
+            perOperation.push_back(QuickLogger::TscClock::ToNanoseconds(end - begin) / (double)batch);
+        }
+    }
+    std::sort(perOperation.begin(), perOperation.end());
+    StageResult result;
+    result.median = perOperation[perOperation.size() / 2];
+    result.minimum = perOperation.front();
+    result.p90 = perOperation[std::min(perOperation.size() - 1, perOperation.size() * 9 / 10)];
+    return result;
+}
+
+/**
+ * @brief Inputs and outputs of the stages, sized to the batch by Prepare.
+ */
+struct StageState {
+    std::vector<QuickLogger::Log>                   logs;
+    std::vector<QuickLogger::Log*>                  pointers;
+    std::vector<QuickLogger::Log*>                  popped;
+    std::vector<QuickLogger::Log::saved_operation>  operations;
+    std::vector<std::string>                        lines;
+    std::vector<std::chrono::system_clock::time_point> times;
+    std::vector<uint64_t>                           ticks;
+    std::string                                     longString = std::string(256, 'x');
+    QuickLogger::LogQueue                           queue;
+    std::FILE*                                      file = nullptr;
+    QuickLogger::NullSink                           nullSink;
+    QuickLogger::MemorySink                         memorySink{1};
+
+    void Prepare(size_t batch){
+        logs.resize(batch);
+        pointers.resize(batch, nullptr);
+        popped.resize(batch, nullptr);
+        operations.resize(batch);
+        lines.resize(batch);
+        times.resize(batch);
+        ticks.resize(batch);
+    }
+
+    /**
+     * @brief Empties the queue, which only ever holds pointers into logs.
+     */
+    void DrainQueue(){
+        QuickLogger::Log* log;
+        while(queue.try_pop(log)){
+        }
+    }
+
+    /**
+     * @brief Resets the Logs to unformatted Logs of the format string, as the consumer pops them.
+     */
+    void ResetLogs(size_t batch, const std::string &format){
+        Prepare(batch);
+        auto now = std::chrono::system_clock::now();
+        for(size_t i = 0 ; i < batch ; i++){
+            logs[i] = QuickLogger::Log();
+            logs[i].value = format;
+            logs[i].logLevel = i % QuickLogger::LOG_TYPES;
+            logs[i].time = now + std::chrono::nanoseconds(i * 37);
+        }
+    }
+
+    /**
+     * @brief Resets the Logs and their rendered lines, the input of the sinks.
+     */
+    void ResetLines(size_t batch){
+        ResetLogs(batch, "LOGGING 1234 0.25 filled");
+        const std::string id = "0", none;
+        for(size_t i = 0 ; i < batch ; i++){
+            lines[i] = QuickLogger::QuickLogger::instance().RenderLine(&logs[i], id, none, none);
+        }
+    }
+};
+
+/**
+ * @brief Adds the build_operation and do_operation stages for one set of arguments.
+ */
+template<typename Build>
+void AddArgumentStages(std::vector<Stage> &stages, StageState &state, const std::string &name, const std::string &format, Build build){
+    stages.push_back(Stage{"build_operation/" + name, [&state](size_t batch){
+        state.Prepare(batch);
+        std::fill(state.operations.begin(), state.operations.end(), nullptr);
+    }, [&state, build](size_t batch){
+        for(size_t i = 0 ; i < batch ; i++){
+            state.operations[i] = build(state.logs[i], i);
+        }
+        Escape(state.operations.data());
+    }});
+    stages.push_back(Stage{"do_operation/" + name, [&state, format, build](size_t batch){
+        state.ResetLogs(batch, format);
+        for(size_t i = 0 ; i < batch ; i++){
+            state.logs[i].saved_op = build(state.logs[i], i);
+        }
+    }, [&state](size_t batch){
+        for(size_t i = 0 ; i < batch ; i++){
+            state.logs[i].saved_op(&state.logs[i]);
+        }
+        Escape(state.logs.data());
+    }});
+}
+
+std::vector<Stage> MakeStages(StageState &state){
+    std::vector<Stage> stages;
+
+    AddArgumentStages(stages, state, "int", "LOGGING {}", [](const QuickLogger::Log &log, size_t i){
+        return log.BuildOperation(i);
+    });
+    AddArgumentStages(stages, state, "mixed", "LOGGING {} {} {}", [](const QuickLogger::Log &log, size_t i){
+        return log.BuildOperation(i, i * 0.25, "filled");
+    });
+    AddArgumentStages(stages, state, "long_string", "LOGGING {}", [&state](const QuickLogger::Log &log, size_t){
+        return log.BuildOperation(state.longString);
+    });
+
+    stages.push_back(Stage{"log_new", [&state](size_t batch){
+        state.Prepare(batch);
+        for(auto &pointer : state.pointers){
+            delete pointer;
+            pointer = nullptr;
+        }
+    }, [&state](size_t batch){
+        for(size_t i = 0 ; i < batch ; i++){
+            state.pointers[i] = new QuickLogger::Log();
+        }
+        Escape(state.pointers.data());
+    }});
+    stages.push_back(Stage{"log_delete", [&state](size_t batch){
+        state.Prepare(batch);
+        for(auto &pointer : state.pointers){
+            delete pointer;
+            pointer = new QuickLogger::Log();
+        }
+    }, [&state](size_t batch){
+        for(size_t i = 0 ; i < batch ; i++){
+            delete state.pointers[i];
+            state.pointers[i] = nullptr;
+        }
+        Escape(state.pointers.data());
+    }});
+
+    stages.push_back(Stage{"system_clock", [&state](size_t batch){ state.Prepare(batch); }, [&state](size_t batch){
+        for(size_t i = 0 ; i < batch ; i++){
+            state.times[i] = std::chrono::system_clock::now();
+        }
+        Escape(state.times.data());
+    }});
+    stages.push_back(Stage{"tsc", [&state](size_t batch){ state.Prepare(batch); }, [&state](size_t batch){
+        for(size_t i = 0 ; i < batch ; i++){
+            state.ticks[i] = QuickLogger::TscClock::now();
+        }
+        Escape(state.ticks.data());
+    }});
+
+    stages.push_back(Stage{"queue_push", [&state](size_t batch){
+        state.Prepare(batch);
+        state.DrainQueue();
+    }, [&state](size_t batch){
+        for(size_t i = 0 ; i < batch ; i++){
+            state.queue.push(&state.logs[i]);
+        }
+    }});
+    stages.push_back(Stage{"queue_pop", [&state](size_t batch){
+        state.Prepare(batch);
+        state.DrainQueue();
+        for(size_t i = 0 ; i < batch ; i++){
+            state.queue.push(&state.logs[i]);
+        }
+    }, [&state](size_t batch){
+        size_t count = 0;
+        for(size_t i = 0 ; i < batch ; i++){
+            count += state.queue.try_pop(state.popped[i]);
+        }
+        Escape(&count);
+        Escape(state.popped.data());
+    }});
+
+    stages.push_back(Stage{"format_time", [&state](size_t batch){ state.ResetLogs(batch, "LOGGING"); }, [&state](size_t batch){
+        for(size_t i = 0 ; i < batch ; i++){
+            state.lines[i] = QuickLogger::QuickLogger::FormatTime(&state.logs[i]);
+        }
+        Escape(state.lines.data());
+    }});
+    stages.push_back(Stage{"render_line", [&state](size_t batch){ state.ResetLogs(batch, "LOGGING 1234 0.25 filled"); }, [&state](size_t batch){
+        QuickLogger::QuickLogger &logger = QuickLogger::QuickLogger::instance();
+        const std::string id = "0", none;
+        for(size_t i = 0 ; i < batch ; i++){
+            state.lines[i] = logger.RenderLine(&state.logs[i], id, none, none);
+        }
+        Escape(state.lines.data());
+    }});
+
+    stages.push_back(Stage{"sink_file", [&state](size_t batch){ state.ResetLines(batch); }, [&state](size_t batch){
+        for(size_t i = 0 ; i < batch ; i++){
+            fmt::print(state.file, "{}", state.lines[i]);
+        }
+    }});
+    stages.push_back(Stage{"sink_null", [&state](size_t batch){ state.ResetLines(batch); }, [&state](size_t batch){
+        QuickLogger::LogSink* sink = &state.nullSink;
+        for(size_t i = 0 ; i < batch ; i++){
+            sink->write(&state.logs[i], 0, state.lines[i]);
+        }
+    }});
+    stages.push_back(Stage{"sink_memory", [&state](size_t batch){ state.ResetLines(batch); }, [&state](size_t batch){
+        QuickLogger::LogSink* sink = &state.memorySink;
+        for(size_t i = 0 ; i < batch ; i++){
+            sink->write(&state.logs[i], 0, state.lines[i]);
+        }
+    }});
+    return stages;
+}
+
+std::vector<std::string> SplitList(const std::string &list){
+    std::vector<std::string> values;
+    std::stringstream stream(list);
+    std::string value;
+    while(std::getline(stream, value, ',')){
+        values.push_back(value);
+    }
+    return values;
+}
+
+void Usage(const char* name){
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --stage LIST          stages to run, a name or a prefix like do_operation (all)\n"
+            "  --rounds N            timed rounds per stage (30)\n"
+            "  --batch N             operations per round (10000)\n"
+            "  --cpu N               pin the benchmark to this CPU (not pinned)\n"
+            "  --format text|csv     result format (text)\n", name);
+}
+
+int main(int argc, char** argv){
+    std::vector<std::string> selected;
+    int rounds = 30, cpu = -1;
+    size_t batch = 10000;
+    std::string format = "text";
+    try{
+        for(int i = 1 ; i < argc ; i++){
+            std::string option = argv[i];
+            if(option == "--help" || i + 1 >= argc){
+                Usage(argv[0]);
+                return option == "--help" ? 0 : 1;
+            }
+            std::string value = argv[++i];
+            if(option == "--stage"){
+                selected = SplitList(value);
+            }
+            else if(option == "--rounds"){
+                rounds = std::max(std::stoi(value), 1);
+            }
+            else if(option == "--batch"){
+                batch = std::max<size_t>(std::stod(value), 1);
+            }
+            else if(option == "--cpu"){
+                cpu = std::stoi(value);
+            }
+            else if(option == "--format" && (value == "text" || value == "csv")){
+                format = value;
+            }
+            else{
+                Usage(argv[0]);
+                return 1;
+            }
+        }
+    }
+    catch(const std::exception &e){
+        fprintf(stderr, "Invalid argument: %s\n", e.what());
+        return 1;
+    }
+
+    if(cpu >= 0){
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(cpu, &mask);
+        sched_setaffinity(0, sizeof(mask), &mask);
+    }
+    QuickLogger::TscClock::Calibrate(std::chrono::milliseconds(100));
+
+    StageState state;
+    std::filesystem::create_directories("logs");
+    state.file = std::fopen("logs/stage_benchmark.log", "w");
+    if(state.file == nullptr){
+        fprintf(stderr, "Unable to open logs/stage_benchmark.log\n");
+        return 1;
+    }
+
+    if(format == "csv"){
+        printf("stage,batch,rounds,median_ns,min_ns,p90_ns\n");
+    }
+    else{
+        printf("%-28s %12s %12s %12s   (ns per operation, %d rounds of %zu)\n", "stage", "median", "min", "p90", rounds, batch);
+    }
+    for(auto &stage : MakeStages(state)){
+        if(!selected.empty() && std::none_of(selected.begin(), selected.end(), [&](const std::string &s){ return stage.name.compare(0, s.size(), s) == 0; })){
+            continue;
+        }
+        StageResult result = RunStage(stage, rounds, batch);
+        if(format == "csv"){
+            printf("%s,%zu,%d,%.2f,%.2f,%.2f\n", stage.name.c_str(), batch, rounds, result.median, result.minimum, result.p90);
+        }
+        else{
+            printf("%-28s %12.2f %12.2f %12.2f\n", stage.name.c_str(), result.median, result.minimum, result.p90);
+        }
+        fflush(stdout);
+    }
+
+    state.DrainQueue();
+    for(auto pointer : state.pointers){
+        delete pointer;
+    }
+    std::fclose(state.file);
+    return 0;
+}
@@ -0,0 +1,90 @@
+/**
+ * @brief Checks that a consumer the watchdog found stalled recovers once it comes back.
+ *
+ * Consumer 0 blocks for 500 ms in its first write while Logs keep arriving for both queues.
+ * The watchdog has to report it stalled, reroute its Logs, and report it recovered after the
+ * write returned, after which consumer 0 writes Logs again. Returns 0 if all of that happened.
+ */
+
+#include "QuickLogger.hpp"
+
+#include <cstdio>
+#include <filesystem>
+
+struct SlowSink : public QuickLogger::LogSink {
+    std::atomic<bool>      blocked{false};
+    std::atomic<u_int64_t> written[2] = {};
+    std::atomic<bool>      stalledLine{false};
+    std::atomic<bool>      recoveredLine{false};
+
+    void write(const QuickLogger::Log*, int consumerID, const std::string &line) override {
+        if(consumerID == 0 && !blocked.exchange(true)){
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        }
+        if(line.find("CONSUMER STALLED") != std::string::npos){
+            stalledLine = true;
+        }
+        if(line.find("CONSUMER RECOVERED") != std::string::npos){
+            recoveredLine = true;
+        }
+        if(consumerID >= 0 && consumerID < 2){
+            written[consumerID]++;
+        }
+    }
+};
+
+int main(){
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "quick_logger_watchdog_test";
+    std::filesystem::create_directories(directory);
+
+    auto &myLogger = QuickLogger::QuickLogger::instance();
+    auto sink = std::make_shared<SlowSink>();
+    std::mutex lock;
+    std::vector<QuickLogger::StallEvent> events;
+    u_int64_t writtenAtRecovery = 0;
+    myLogger.setFileOutput(false);
+    myLogger.addSink(sink);
+    myLogger.enableWatchdog(std::chrono::milliseconds(50), [&](const QuickLogger::StallEvent &event){
+        std::lock_guard<std::mutex> guard(lock);
+        events.push_back(event);
+        if(event.consumerID == 0 && !event.stalled){
+            writtenAtRecovery = sink->written[0].load();
+        }
+    });
+    int consumers = 2;
+    myLogger.Initialize(myLogger, consumers, directory, false);
+    myLogger.start();
+
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(1500);
+    for(int i = 0 ; std::chrono::steady_clock::now() < end ; i++){
+        myLogger.LogItem(QuickLogger::INFO, i % 2, "log {}", i);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    STOP_QUICK_LOGGER(myLogger);
+
+    bool stalled = false, recovered = false;
+    for(auto &event : events){
+        printf("consumer %d %s, queue depth %llu, %lld ms\n", event.consumerID, event.stalled ? "stalled" : "recovered",
+               (unsigned long long)event.queueDepth, (long long)event.stalledFor.count());
+        if(event.consumerID == 0){
+            stalled = stalled || event.stalled;
+            recovered = recovered || (stalled && !event.stalled);
+        }
+    }
+    u_int64_t writtenAfter = sink->written[0].load() - writtenAtRecovery;
+    printf("consumer 0 wrote %llu Logs after it recovered\n", (unsigned long long)writtenAfter);
+
+    int failures = 0;
+    auto check = [&](bool condition, const char* what){
+        if(!condition){
+            printf("FAILED: %s\n", what);
+            failures++;
+        }
+    };
+    check(stalled, "consumer 0 reported stalled");
+    check(recovered, "consumer 0 reported recovered after the stall");
+    check(sink->stalledLine && sink->recoveredLine, "CONSUMER STALLED and CONSUMER RECOVERED lines written");
+    check(writtenAfter > 0, "consumer 0 writes again after it recovered");
+    std::filesystem::remove_all(directory);
+    return failures == 0 ? 0 : 1;
+}
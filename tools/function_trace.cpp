@@ -0,0 +1,297 @@
+/**
+ * @brief Offline viewer for the function traces written by QuickLogger.
+ *
+ * Reads the FUNCTIONS_<consumer>.trace files written when QuickLogger is built with
+ * QUICK_LOGGER_FUNCTION_TRACE and the program with -finstrument-functions, symbolizes
+ * the function addresses using the ELF symbol table of the traced executable and prints
+ * the call tree of every thread with call counts and inclusive/self times, followed by a
+ * flat profile.
+ *
+ * Usage: function_trace <executable> <trace files...>
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cxxabi.h>
+#include <elf.h>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+
+struct Symbol {
+    uint64_t    address;
+    uint64_t    size;
+    std::string name;
+};
+
+struct Event {
+    uint64_t address;
+    uint64_t tsc;
+};
+
+/**
+ * @brief Node of a call tree, keyed by the function address below its parent.
+ */
+struct CallNode {
+    uint64_t address = 0;
+    uint64_t calls = 0;
+    uint64_t totalTicks = 0;
+    uint64_t childTicks = 0;
+    std::map<uint64_t, std::unique_ptr<CallNode>> children;
+};
+
+struct Frame {
+    CallNode* node;
+    uint64_t  tsc;
+};
+
+/**
+ * @brief Events of one traced thread in one session (one header chunk).
+ */
+struct ThreadTrace {
+    double             nanosecondsPerTick = 1.0;
+    uint64_t           bias = 0;
+    uint64_t           dropped = 0;
+    std::vector<Event> events;
+};
+
+static const uint64_t EXIT_FLAG = 1ULL << 63;
+
+
+/**
+ * @brief Reads the function symbols of an ELF64 executable, sorted by address.
+ */
+std::vector<Symbol> ReadSymbols(const std::string &path){
+    std::vector<Symbol> symbols;
+    std::ifstream in(path, std::ios::binary);
+    std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if(data.size() < sizeof(Elf64_Ehdr) || std::memcmp(data.data(), ELFMAG, SELFMAG) != 0 || data[EI_CLASS] != ELFCLASS64){
+        fprintf(stderr, "%s is not an ELF64 file\n", path.c_str());
+        return symbols;
+    }
+
+    const Elf64_Ehdr* header = (const Elf64_Ehdr*)data.data();
+    if(header->e_shoff == 0 || header->e_shoff + (uint64_t)header->e_shnum * sizeof(Elf64_Shdr) > data.size()){
+        fprintf(stderr, "%s has no section headers\n", path.c_str());
+        return symbols;
+    }
+    const Elf64_Shdr* sections = (const Elf64_Shdr*)(data.data() + header->e_shoff);
+
+    for(int type : {SHT_SYMTAB, SHT_DYNSYM}){
+        for(int i = 0 ; i < header->e_shnum ; i++){
+            const Elf64_Shdr &section = sections[i];
+            if((int)section.sh_type != type || section.sh_link >= header->e_shnum){
+                continue;
+            }
+            const Elf64_Shdr &strings = sections[section.sh_link];
+            if(section.sh_offset + section.sh_size > data.size() || strings.sh_offset + strings.sh_size > data.size()){
+                continue;
+            }
+            const Elf64_Sym* entries = (const Elf64_Sym*)(data.data() + section.sh_offset);
+            size_t count = section.sh_size / sizeof(Elf64_Sym);
+            for(size_t j = 0 ; j < count ; j++){
+                const Elf64_Sym &entry = entries[j];
+                if(ELF64_ST_TYPE(entry.st_info) != STT_FUNC || entry.st_value == 0 || entry.st_name >= strings.sh_size){
+                    continue;
+                }
+                symbols.push_back(Symbol{entry.st_value, entry.st_size, data.data() + strings.sh_offset + entry.st_name});
+            }
+        }
+        if(!symbols.empty()){
+            break;
+        }
+    }
+
+    std::sort(symbols.begin(), symbols.end(), [](const Symbol &a, const Symbol &b){ return a.address < b.address; });
+    return symbols;
+}
+
+/**
+ * @brief Returns the demangled name of the function containing address, or the address in hex.
+ */
+std::string Symbolize(const std::vector<Symbol> &symbols, uint64_t address){
+    auto it = std::upper_bound(symbols.begin(), symbols.end(), address, [](uint64_t a, const Symbol &s){ return a < s.address; });
+    if(it != symbols.begin()){
+        --it;
+        if(address < it->address + std::max<uint64_t>(it->size, 1)){
+            int status = 0;
+            char* demangled = abi::__cxa_demangle(it->name.c_str(), nullptr, nullptr, &status);
+            std::string name = status == 0 && demangled != nullptr ? demangled : it->name;
+            free(demangled);
+            return name;
+        }
+    }
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "0x%llx", (unsigned long long)address);
+    return buffer;
+}
+
+typedef std::tuple<std::string, int, uint32_t> TraceKey;
+
+/**
+ * @brief Reads one trace file into traces, keyed by file, session and thread.
+ *
+ * Every header chunk starts a new session, i.e. a new run of the Logger appending to the file.
+ *
+ * @return                  `false` if the file could not be read
+ */
+bool ReadTrace(const std::string &path, const std::vector<Symbol> &symbols, std::map<TraceKey, ThreadTrace> &traces){
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if(file == nullptr){
+        fprintf(stderr, "Unable to open %s\n", path.c_str());
+        return false;
+    }
+
+    uint64_t reference = 0;
+    for(auto &symbol : symbols){
+        if(symbol.name == "__cyg_profile_func_enter"){
+            reference = symbol.address;
+            break;
+        }
+    }
+
+    int session = 0;
+    double nanosecondsPerTick = 1.0;
+    uint64_t bias = 0;
+    uint32_t type;
+    while(std::fread(&type, sizeof(type), 1, file) == 1){
+        if(type == 1){
+            uint32_t version;
+            uint64_t runtimeReference;
+            if(std::fread(&version, sizeof(version), 1, file) != 1 || std::fread(&nanosecondsPerTick, sizeof(double), 1, file) != 1 ||
+               std::fread(&runtimeReference, sizeof(runtimeReference), 1, file) != 1){
+                break;
+            }
+            bias = reference != 0 ? runtimeReference - reference : 0;
+            session++;
+        }
+        else if(type == 2){
+            uint32_t chunk[3];
+            uint64_t dropped;
+            if(std::fread(chunk, sizeof(chunk), 1, file) != 1 || std::fread(&dropped, sizeof(dropped), 1, file) != 1){
+                break;
+            }
+            ThreadTrace &trace = traces[TraceKey(path, session, chunk[0])];
+            trace.nanosecondsPerTick = nanosecondsPerTick;
+            trace.bias = bias;
+            trace.dropped = dropped;
+            size_t offset = trace.events.size();
+            trace.events.resize(offset + chunk[1]);
+            if(std::fread(trace.events.data() + offset, sizeof(Event), chunk[1], file) != chunk[1]){
+                trace.events.resize(offset);
+                break;
+            }
+        }
+        else{
+            fprintf(stderr, "%s: unknown chunk type %u\n", path.c_str(), type);
+            break;
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+/**
+ * @brief Builds the call tree of one thread. Calls still open at the end of the trace are
+ * closed at the time of the last event.
+ */
+void BuildTree(const ThreadTrace &trace, CallNode &root){
+    std::vector<Frame> stack;
+    stack.push_back(Frame{&root, trace.events.empty() ? 0 : trace.events.front().tsc & ~EXIT_FLAG});
+    uint64_t last = stack.back().tsc;
+
+    auto close = [&stack](uint64_t tsc){
+        Frame frame = stack.back();
+        stack.pop_back();
+        uint64_t ticks = tsc > frame.tsc ? tsc - frame.tsc : 0;
+        frame.node->totalTicks += ticks;
+        stack.back().node->childTicks += ticks;
+    };
+
+    for(auto &event : trace.events){
+        uint64_t tsc = event.tsc & ~EXIT_FLAG;
+        uint64_t address = event.address - trace.bias;
+        last = tsc;
+        if(event.tsc & EXIT_FLAG){
+            // Exits without a matching entry happen when the trace started inside a call
+            // or events were dropped, unwind to the matching frame if there is one.
+            auto match = std::find_if(stack.rbegin(), stack.rend() - 1, [address](const Frame &f){ return f.node->address == address; });
+            if(match == stack.rend() - 1){
+                continue;
+            }
+            while(stack.back().node->address != address){
+                close(tsc);
+            }
+            close(tsc);
+        }
+        else{
+            auto &child = stack.back().node->children[address];
+            if(!child){
+                child.reset(new CallNode());
+                child->address = address;
+            }
+            child->calls++;
+            stack.push_back(Frame{child.get(), tsc});
+        }
+    }
+    while(stack.size() > 1){
+        close(last);
+    }
+}
+
+void PrintTree(const CallNode &node, const std::vector<Symbol> &symbols, double nanosecondsPerTick, int depth,
+               std::map<uint64_t, std::pair<uint64_t, uint64_t>> &flat){
+    std::vector<const CallNode*> children;
+    for(auto &child : node.children){
+        children.push_back(child.second.get());
+    }
+    std::sort(children.begin(), children.end(), [](const CallNode* a, const CallNode* b){ return a->totalTicks > b->totalTicks; });
+    for(auto child : children){
+        uint64_t self = child->totalTicks > child->childTicks ? child->totalTicks - child->childTicks : 0;
+        printf("%*s%s  calls=%llu total=%.3fus self=%.3fus\n", 2 * depth, "", Symbolize(symbols, child->address).c_str(),
+               (unsigned long long)child->calls, child->totalTicks * nanosecondsPerTick / 1000, self * nanosecondsPerTick / 1000);
+        flat[child->address].first += child->calls;
+        flat[child->address].second += self;
+        PrintTree(*child, symbols, nanosecondsPerTick, depth + 1, flat);
+    }
+}
+
+int main(int argc, char** argv){
+    if(argc < 3){
+        fprintf(stderr, "Usage: %s <executable> <trace files...>\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<Symbol> symbols = ReadSymbols(argv[1]);
+    std::map<TraceKey, ThreadTrace> traces;
+    for(int i = 2 ; i < argc ; i++){
+        ReadTrace(argv[i], symbols, traces);
+    }
+
+    std::map<uint64_t, std::pair<uint64_t, uint64_t>> flat;
+    double nanosecondsPerTick = 1.0;
+    for(auto &entry : traces){
+        ThreadTrace &trace = entry.second;
+        nanosecondsPerTick = trace.nanosecondsPerTick;
+        printf("%s session %d, thread %u: %zu events, %llu dropped\n", std::get<0>(entry.first).c_str(), std::get<1>(entry.first), std::get<2>(entry.first),
+               trace.events.size(), (unsigned long long)trace.dropped);
+        CallNode root;
+        BuildTree(trace, root);
+        PrintTree(root, symbols, trace.nanosecondsPerTick, 1, flat);
+        printf("\n");
+    }
+
+    std::vector<std::pair<uint64_t, std::pair<uint64_t, uint64_t>>> profile(flat.begin(), flat.end());
+    std::sort(profile.begin(), profile.end(), [](const auto &a, const auto &b){ return a.second.second > b.second.second; });
+    printf("Flat profile (self time):\n");
+    for(auto &entry : profile){
+        printf("  %12.3fus  calls=%-10llu %s\n", entry.second.second * nanosecondsPerTick / 1000,
+               (unsigned long long)entry.second.first, Symbolize(symbols, entry.first).c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,176 @@
+/**
+ * @brief Offline completeness check of the log files written by QuickLogger.
+ *
+ * Reads log files written with enableSequenceNumbers, text or JSON lines, collects the
+ * sequence numbers per session, queue and producer over all given files and prints every
+ * gap, i.e. Logs which were sent but never written. The "gap: N records lost" lines the
+ * consumers wrote themselves are counted too, so both views can be compared. Logs lost after
+ * the last written Log of a stream only show up in those lines. Logs aggregated into metrics
+ * are not written; the "aggregated: N records" lines account for them, so a stream with
+ * aggregated Logs is only checked for the total it misses, not for the position of the gaps.
+ *
+ * Usage: sequence_check <log files...>
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+
+typedef std::tuple<int, long, long> StreamKey;
+
+/**
+ * @brief Logs of a stream aggregated by the consumers, and the highest sequence number among them.
+ */
+struct Aggregated {
+    unsigned long long count = 0;
+    unsigned long long last = 0;
+};
+
+static const char* SESSION_MARKER = "-------------Starting new Session---------------";
+
+
+/**
+ * @brief Reads the integer following key in line.
+ *
+ * @return                  `false` if the key is not in the line
+ */
+bool ReadNumber(const std::string &line, const char* key, unsigned long long &value){
+    size_t position = line.find(key);
+    if(position == std::string::npos){
+        return false;
+    }
+    const char* begin = line.c_str() + position + std::strlen(key);
+    char* end = nullptr;
+    value = std::strtoull(begin, &end, 10);
+    return end != begin;
+}
+
+/**
+ * @brief Parses queue, producer and sequence number of one text or JSON line.
+ *
+ * @return                  `false` if the line carries no sequence number
+ */
+bool ParseLine(const std::string &line, unsigned long long &queue, unsigned long long &producer, unsigned long long &sequence){
+    if(!line.empty() && line[0] == '{'){
+        return ReadNumber(line, "\"thread\":", queue) && ReadNumber(line, "\"producer\":", producer) &&
+               ReadNumber(line, "\"seq\":", sequence);
+    }
+    size_t position = line.find("\tseq=");
+    if(position == std::string::npos || !ReadNumber(line, "Thread ID : ", queue)){
+        return false;
+    }
+    const char* begin = line.c_str() + position + 5;
+    char* end = nullptr;
+    producer = std::strtoull(begin, &end, 10);
+    if(end == begin || *end != ':'){
+        return false;
+    }
+    begin = end + 1;
+    sequence = std::strtoull(begin, &end, 10);
+    return end != begin;
+}
+
+/**
+ * @brief Parses an "aggregated: N records" line, text or JSON.
+ *
+ * @return                  `false` if the line is not one
+ */
+bool ParseAggregated(const std::string &line, unsigned long long &queue, unsigned long long &producer, Aggregated &aggregated){
+    if(!ReadNumber(line, "aggregated: ", aggregated.count)){
+        return false;
+    }
+    if(!line.empty() && line[0] == '{'){
+        return ReadNumber(line, "\"queue\":", queue) && ReadNumber(line, "\"producer\":", producer) &&
+               ReadNumber(line, "\"last_seq\":", aggregated.last);
+    }
+    return ReadNumber(line, " queue=", queue) && ReadNumber(line, " producer=", producer) &&
+           ReadNumber(line, " last_seq=", aggregated.last);
+}
+
+int main(int argc, char** argv){
+    if(argc < 2){
+        fprintf(stderr, "Usage: %s <log files...>\n", argv[0]);
+        return 1;
+    }
+
+    std::map<StreamKey, std::vector<unsigned long long>> streams;
+    std::map<StreamKey, Aggregated> aggregatedStreams;
+    unsigned long long reported = 0;
+    for(int i = 1 ; i < argc ; i++){
+        std::ifstream in(argv[i]);
+        if(!in){
+            fprintf(stderr, "Unable to open %s\n", argv[i]);
+            continue;
+        }
+        int session = 0;
+        std::string line;
+        while(std::getline(in, line)){
+            if(line.find(SESSION_MARKER) != std::string::npos){
+                session++;
+                continue;
+            }
+            unsigned long long queue, producer, sequence, lost;
+            Aggregated aggregated;
+            if(ParseLine(line, queue, producer, sequence)){
+                streams[StreamKey(session, queue, producer)].push_back(sequence);
+            }
+            else if(ParseAggregated(line, queue, producer, aggregated)){
+                Aggregated &total = aggregatedStreams[StreamKey(session, queue, producer)];
+                total.count += aggregated.count;
+                total.last = std::max(total.last, aggregated.last);
+            }
+            else if(ReadNumber(line, "gap: ", lost)){
+                reported += lost;
+            }
+        }
+    }
+
+    for(auto &entry : aggregatedStreams){
+        streams[entry.first];
+    }
+
+    unsigned long long records = 0, missing = 0, duplicates = 0, aggregatedRecords = 0;
+    for(auto &entry : streams){
+        std::vector<unsigned long long> &sequences = entry.second;
+        std::sort(sequences.begin(), sequences.end());
+        records += sequences.size();
+        auto aggregated = aggregatedStreams.find(entry.first);
+        unsigned long long next = 0, streamMissing = 0;
+        for(auto sequence : sequences){
+            if(sequence < next){
+                duplicates++;
+                continue;
+            }
+            if(sequence > next && aggregated == aggregatedStreams.end()){
+                printf("session %d queue %ld producer %ld: %llu records lost from %llu\n", std::get<0>(entry.first),
+                       std::get<1>(entry.first), std::get<2>(entry.first), sequence - next, next);
+            }
+            streamMissing += sequence - next;
+            next = sequence + 1;
+        }
+        if(aggregated != aggregatedStreams.end()){
+            // The gaps hold the aggregated Logs, those after the last written one extend the stream.
+            unsigned long long count = aggregated->second.count;
+            unsigned long long end = std::max(next, aggregated->second.last + 1);
+            streamMissing += end - next;
+            aggregatedRecords += count;
+            streamMissing = streamMissing > count ? streamMissing - count : 0;
+            if(streamMissing > 0){
+                printf("session %d queue %ld producer %ld: %llu records lost besides %llu aggregated\n", std::get<0>(entry.first),
+                       std::get<1>(entry.first), std::get<2>(entry.first), streamMissing, count);
+            }
+        }
+        missing += streamMissing;
+    }
+
+    printf("%llu records in %zu streams, %llu aggregated, %llu missing, %llu duplicated, %llu reported lost by the consumers\n",
+           records, streams.size(), aggregatedRecords, missing, duplicates, reported);
+    return missing > 0 || duplicates > 0 ? 2 : 0;
+}